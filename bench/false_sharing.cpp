@@ -0,0 +1,233 @@
+#include "threadpool.hpp"
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * 在同一个程序里对比ThreadPool改动前后的成员布局，每个任务走同样的提交/取任务/执行路径：
+ * old：原布局，队列、锁、条件变量、空闲计数挨在一起，工作线程在锁外也要改空闲计数
+ * new：现布局，锁和队列、两个条件变量各占缓存行，工作线程只写自己缓存行里的busy标记
+ * 两者都按cached模式维护空闲状态（fixed模式现在不再维护）
+ * pool：真实ThreadPool(fixed模式)的提交/执行路径
+ * 用perf硬件计数器统计整个过程的缓存未命中
+ * 伪共享只在多核上出现，单核机器上old和new没有差别
+ *
+ * usage: ./false_sharing_bench [工作线程数] [任务数]
+ */
+
+using Task = std::function<void()>;
+
+// 原布局 成员顺序同改动前的ThreadPool
+struct OldLayout
+{
+    std::queue<Task> taskQue_;
+    std::atomic_int taskSize_{0};
+    int taskQueThreshold_ = TASK_MAX_THRESHOLD;
+    std::mutex taskQueMtx_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    std::atomic_bool isPoolRunning_{true};
+    std::atomic_int idleThreadSize_{0};
+
+    // 取到任务时在锁内调用，执行完在锁外调用
+    void taskBegin(int)
+    {
+        idleThreadSize_--;
+    }
+    void taskEnd(int)
+    {
+        idleThreadSize_++;
+    }
+};
+
+// 现布局 成员分组同现在的ThreadPool
+struct NewLayout
+{
+    struct alignas(CACHE_LINE_SIZE) WorkerSlot
+    {
+        std::atomic_bool busy{false};
+    };
+
+    int taskQueThreshold_ = TASK_MAX_THRESHOLD;
+    std::atomic_bool isPoolRunning_{true};
+    WorkerSlot slots_[THREAD_MAX_THRESHOLD];
+
+    alignas(CACHE_LINE_SIZE) std::mutex taskQueMtx_;
+    std::queue<Task> taskQue_;
+    int taskSize_ = 0;
+
+    alignas(CACHE_LINE_SIZE) std::condition_variable notEmpty_;
+    alignas(CACHE_LINE_SIZE) std::condition_variable notFull_;
+
+    void taskBegin(int id)
+    {
+        slots_[id].busy.store(true, std::memory_order_relaxed);
+    }
+    void taskEnd(int id)
+    {
+        slots_[id].busy.store(false, std::memory_order_relaxed);
+    }
+};
+
+// 硬件计数器 打不开时返回-1，只输出耗时
+static int openCounter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1; // 统计之后创建的子线程
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+struct Counters
+{
+    int fds[2];
+    Counters()
+    {
+        fds[0] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[1] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+    ~Counters()
+    {
+        for (int fd : fds)
+            if (fd >= 0)
+                ::close(fd);
+    }
+    void start()
+    {
+        for (int fd : fds)
+        {
+            if (fd < 0)
+                continue;
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    void stop(long long out[2])
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            out[i] = -1;
+            if (fds[i] < 0)
+                continue;
+            ::ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(fds[i], &out[i], sizeof(out[i])) != sizeof(out[i]))
+                out[i] = -1;
+        }
+    }
+};
+
+// 计时并统计body执行期间的缓存未命中
+template <typename Body>
+static void measure(const char *name, Body body)
+{
+    Counters counters;
+    long long value[2];
+    auto begin = std::chrono::steady_clock::now();
+    counters.start();
+    body();
+    counters.stop(value);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << name << ": " << ms << " ms";
+    if (value[0] >= 0)
+        std::cout << ", cache-misses " << value[0];
+    if (value[1] >= 0)
+        std::cout << ", L1D-load-misses " << value[1];
+    if (value[0] < 0 && value[1] < 0)
+        std::cout << " (perf counters unavailable)";
+    std::cout << std::endl;
+}
+
+// 按ThreadPool的提交和工作线程逻辑跑一遍，只有State的布局不同
+template <typename State>
+static void runLayout(const char *name, int threadSize, long tasks)
+{
+    auto state = std::make_unique<State>();
+    State &s = *state;
+    std::atomic_long done{0};
+    measure(name, [&]()
+            {
+                std::vector<std::thread> workers;
+                for (int id = 0; id < threadSize; id++)
+                {
+                    workers.emplace_back([&s, id]()
+                                         {
+                                             for (;;)
+                                             {
+                                                 Task task;
+                                                 {
+                                                     std::unique_lock<std::mutex> lock(s.taskQueMtx_);
+                                                     s.notEmpty_.wait(lock, [&]() -> bool
+                                                                      { return s.taskQue_.size() > 0 || !s.isPoolRunning_; });
+                                                     if (s.taskQue_.empty())
+                                                         return;
+                                                     s.taskBegin(id);
+                                                     task = std::move(s.taskQue_.front());
+                                                     s.taskQue_.pop();
+                                                     s.taskSize_--;
+                                                     if (s.taskQue_.size() > 0)
+                                                         s.notEmpty_.notify_all();
+                                                     s.notFull_.notify_all();
+                                                 }
+                                                 task();
+                                                 s.taskEnd(id);
+                                             } });
+                }
+                for (long i = 0; i < tasks; i++)
+                {
+                    std::unique_lock<std::mutex> lock(s.taskQueMtx_);
+                    s.notFull_.wait(lock, [&]() -> bool
+                                    { return static_cast<int>(s.taskQue_.size()) < s.taskQueThreshold_; });
+                    s.taskQue_.emplace([&done]()
+                                       { done.fetch_add(1, std::memory_order_relaxed); });
+                    s.taskSize_++;
+                    s.notEmpty_.notify_all();
+                }
+                {
+                    std::unique_lock<std::mutex> lock(s.taskQueMtx_);
+                    s.isPoolRunning_ = false;
+                }
+                s.notEmpty_.notify_all();
+                for (std::thread &t : workers)
+                    t.join(); });
+}
+
+int main(int argc, char **argv)
+{
+    int threadSize = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    long tasks = argc > 2 ? std::atol(argv[2]) : 1000000;
+    threadSize = std::max(1, std::min(threadSize, THREAD_MAX_THRESHOLD));
+    std::cout << threadSize << " threads, " << tasks << " tasks" << std::endl;
+
+    runLayout<OldLayout>("old", threadSize, tasks);
+    runLayout<NewLayout>("new", threadSize, tasks);
+
+    // 线程池每个任务都会输出日志，测量期间关掉标准输出
+    std::atomic_long done{0};
+    {
+        ThreadPool pool;
+        pool.start(threadSize);
+        measure("pool", [&]()
+                {
+                    std::cout.setstate(std::ios::failbit);
+                    for (long i = 0; i < tasks; i++)
+                        pool.submitTask([&done]()
+                                        { done++; });
+                    while (done < tasks)
+                        std::this_thread::yield();
+                    std::cout.clear(); });
+        // 析构时的线程退出日志也不输出
+        std::cout.setstate(std::ios::failbit);
+    }
+    std::cout.clear();
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include <thread>
 #include <iostream>
 #include <unordered_map>
+#include <exception>
 
 // Any类型：接收任意数据类型 这是一个模板类
 class Any
@@ -113,10 +114,15 @@ public:
     // 获取任务执行完的返回值
     void setVal(Any any);
 
+    // 任务抛出异常，记录下来并唤醒等待的用户线程
+    void setException(std::exception_ptr ex);
+
+    // 任务抛出异常时，get重新抛出该异常
     Any get();
 
 private:
     Any any_;                    // 存储任务的返回值
+    std::exception_ptr ex_;      // 存储任务抛出的异常
     Semaphore sem_;              // 线程通信信号量
     std::shared_ptr<Task> task_; // 指向对应任务对象，目的是拿到task，避免线程完成任务后，task销毁
     std::atomic_bool isValid_;   // 是否有效
@@ -160,8 +166,8 @@ public:
 
 private:
     ThreadFunc func_;
-    static int genId_;
-    int threadId_; // 线程id
+    static std::atomic_int genId_; // 多个线程池可能同时创建线程
+    int threadId_;                 // 线程id
 };
 /**
  * example:
@@ -192,6 +198,13 @@ public:
     // 设置cached模式线程上限阈值
     void setThreadSizeThreshold(int threshold);
 
+    // 设置任务异常回调 任务抛出异常时在工作线程上调用
+    using ErrorHandler = std::function<void(std::exception_ptr)>;
+    void setErrorHandler(ErrorHandler handler);
+
+    // 抛出异常的任务数量
+    long failedTaskCount() const;
+
     // 提交任务
     Result submitTask(std::shared_ptr<Task> sp);
 
@@ -210,6 +223,9 @@ private:
     // 检查pool运行状态
     bool checkRunningState() const;
 
+    // 任务抛出异常：计数并调用异常回调
+    void onTaskError(std::exception_ptr ex);
+
 private:
     // std::vector<std::unique_ptr<Thread>> threads_; // 线程列表
     std::unordered_map<int, std::unique_ptr<Thread>> threads_; // 线程列表
@@ -229,4 +245,7 @@ private:
     PoolMode poolMode_;              // 线程池模式
     std::atomic_bool isPoolRunning_; // 线程池启动状态
     std::atomic_int idleThreadSize_; // 空闲线程数量
+
+    ErrorHandler errorHandler_;       // 任务异常回调
+    std::atomic_long failedTaskSize_; // 抛出异常的任务数量
 };
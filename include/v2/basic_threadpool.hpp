@@ -0,0 +1,710 @@
+#pragma once
+
+#include "threadpool.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 策略模板版线程池
+ * 队列、等待方式、任务存储、线程数量策略都在编译期确定，用不到的分支不会生成代码
+ *
+ * example:
+ * BasicThreadPool<LockFreeQueue, SpinWait, InlineFunction<64>, FixedSize> pool;
+ * pool.start(4);
+ * std::future<int> r = pool.submitTask(add, 1, 2);
+ */
+
+/**
+ * 任务存储
+ */
+
+// 定长内联任务：callable直接放在对象内部的buffer里，不走堆分配，只能移动
+template <std::size_t N>
+class InlineFunction
+{
+public:
+    InlineFunction() = default;
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineFunction>::value>>
+    InlineFunction(F &&func)
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= N, "callable is too large for InlineFunction");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable is over-aligned");
+        ::new (static_cast<void *>(buf_)) Fn(std::forward<F>(func));
+        invoke_ = [](void *p)
+        { (*static_cast<Fn *>(p))(); };
+        // dst非空：移动到dst后析构src；dst为空：只析构src
+        manage_ = [](void *dst, void *src)
+        {
+            if (dst != nullptr)
+                ::new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+            static_cast<Fn *>(src)->~Fn();
+        };
+    }
+    ~InlineFunction()
+    {
+        reset();
+    }
+
+    InlineFunction(InlineFunction &&other) noexcept
+    {
+        moveFrom(other);
+    }
+    InlineFunction &operator=(InlineFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+    InlineFunction(const InlineFunction &) = delete;
+    InlineFunction &operator=(const InlineFunction &) = delete;
+
+    void operator()()
+    {
+        invoke_(buf_);
+    }
+
+    explicit operator bool() const
+    {
+        return invoke_ != nullptr;
+    }
+
+private:
+    void reset()
+    {
+        if (manage_ != nullptr)
+            manage_(nullptr, buf_);
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+    void moveFrom(InlineFunction &other)
+    {
+        if (other.manage_ != nullptr)
+        {
+            other.manage_(buf_, other.buf_);
+            invoke_ = other.invoke_;
+            manage_ = other.manage_;
+            other.invoke_ = nullptr;
+            other.manage_ = nullptr;
+        }
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char buf_[N];
+    void (*invoke_)(void *) = nullptr;
+    void (*manage_)(void *, void *) = nullptr;
+};
+
+/**
+ * 队列策略 模板参数<任务类型, 分配器>
+ * try_push失败时不会移走参数，try_pop失败时不修改参数
+ */
+
+// 互斥锁队列：与ThreadPool的任务队列行为一致
+template <typename T, typename Alloc>
+class MutexQueue
+{
+public:
+    explicit MutexQueue(std::size_t capacity, const Alloc &alloc = Alloc())
+        : capacity_(capacity), que_(alloc)
+    {
+    }
+
+    bool try_push(T &&item)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (que_.size() >= capacity_)
+            return false;
+        que_.emplace_back(std::move(item));
+        return true;
+    }
+
+    bool try_pop(T &item)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (que_.empty())
+            return false;
+        item = std::move(que_.front());
+        que_.pop_front();
+        return true;
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return que_.size();
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    std::size_t capacity_;
+    mutable std::mutex mtx_;
+    std::deque<T, Alloc> que_;
+};
+
+// 无锁有界队列：多生产者多消费者环形缓冲，容量向上取2的幂
+template <typename T, typename Alloc>
+class LockFreeQueue
+{
+public:
+    explicit LockFreeQueue(std::size_t capacity, const Alloc &alloc = Alloc())
+        : alloc_(alloc), mask_(roundUp(capacity) - 1), enqueuePos_(0), dequeuePos_(0)
+    {
+        cells_ = CellTraits::allocate(alloc_, mask_ + 1);
+        for (std::size_t i = 0; i <= mask_; i++)
+        {
+            CellTraits::construct(alloc_, cells_ + i);
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    ~LockFreeQueue()
+    {
+        for (std::size_t i = 0; i <= mask_; i++)
+            CellTraits::destroy(alloc_, cells_ + i);
+        CellTraits::deallocate(alloc_, cells_, mask_ + 1);
+    }
+
+    LockFreeQueue(const LockFreeQueue &) = delete;
+    LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+    bool try_push(T &&item)
+    {
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                // 抢占该槽位
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.data = std::move(item);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // 队列满
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T &item)
+    {
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(cell.data);
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // 队列空
+                return false;
+            }
+            else
+            {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 近似值，只用于扩容判断
+    std::size_t size() const
+    {
+        std::size_t head = dequeuePos_.load(std::memory_order_relaxed);
+        std::size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> seq;
+        T data;
+    };
+    using CellAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Cell>;
+    using CellTraits = std::allocator_traits<CellAlloc>;
+
+    static std::size_t roundUp(std::size_t n)
+    {
+        std::size_t cap = 2;
+        while (cap < n)
+            cap <<= 1;
+        return cap;
+    }
+
+private:
+    CellAlloc alloc_;
+    Cell *cells_;
+    const std::size_t mask_;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> enqueuePos_; // 生产者、消费者位置分开缓存行
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> dequeuePos_;
+};
+
+/**
+ * 等待策略
+ */
+
+// 挂起等待：条件变量，空闲时不占cpu
+class ParkWait
+{
+public:
+    static constexpr bool needsNotify = true; // 等待方只能被notify唤醒
+
+    void notify_one()
+    {
+        // 先拿一次锁，保证等待方不会在检查条件和睡眠之间错过通知
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+        }
+        cond_.notify_one();
+    }
+
+    void notify_all()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+        }
+        cond_.notify_all();
+    }
+
+    template <typename Pred>
+    void wait(Pred pred)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, pred);
+    }
+
+    // 超时返回false
+    template <typename Pred, typename Rep, typename Period>
+    bool wait_for(Pred pred, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        return cond_.wait_for(lock, timeout, pred);
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+// 自旋等待：轮询条件，延迟低但空闲时占cpu，通知为空操作
+class SpinWait
+{
+public:
+    static constexpr bool needsNotify = false; // 等待方自己轮询条件
+
+    void notify_one() {}
+    void notify_all() {}
+
+    template <typename Pred>
+    void wait(Pred pred)
+    {
+        for (int spin = 0; !pred(); spin++)
+            backoff(spin);
+    }
+
+    template <typename Pred, typename Rep, typename Period>
+    bool wait_for(Pred pred, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (int spin = 0; !pred(); spin++)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+                return pred();
+            backoff(spin);
+        }
+        return true;
+    }
+
+private:
+    static void backoff(int spin)
+    {
+        // 先忙等一段，再让出时间片
+        if (spin >= 64)
+            std::this_thread::yield();
+    }
+};
+
+/**
+ * 线程数量策略
+ */
+struct FixedSize
+{
+    static constexpr bool elastic = false; // 固定数量线程
+};
+struct ElasticSize
+{
+    static constexpr bool elastic = true; // 线程数量可动态增长，空闲超时回收
+};
+
+// 策略线程池类型
+template <template <typename, typename> class QueuePolicy,
+          typename WaitPolicy,
+          typename TaskStorage = std::function<void()>,
+          typename SizePolicy = FixedSize,
+          typename Allocator = std::allocator<TaskStorage>>
+class BasicThreadPool
+{
+public:
+    using Queue = QueuePolicy<TaskStorage, Allocator>;
+
+    BasicThreadPool() : initThreadSize_(0),
+                        threadMaxSizeThreshold_(THREAD_MAX_THRESHOLD),
+                        curThreadSize_(0),
+                        taskQue_(std::make_unique<Queue>(TASK_MAX_THRESHOLD)),
+                        taskQueThreshold_(TASK_MAX_THRESHOLD),
+                        isPoolRunning_(false),
+                        waitingProducers_(0),
+                        idleThreadSize_(0),
+                        failedTaskSize_(0)
+    {
+    }
+    ~BasicThreadPool()
+    {
+        isPoolRunning_ = false;
+        notEmpty_.notify_all();
+        // 等待线程池里所有线程返回 阻塞和运行线程
+        std::unique_lock<std::mutex> lock(threadsMtx_);
+        exitCond_.wait(lock, [&]() -> bool
+                       { return threads_.size() == 0; });
+    }
+
+    // 设置task任务上限阈值 启动前且还没有提交任务时才能设置
+    void setTaskQueThreshold(int threshold)
+    {
+        if (checkRunningState() || taskQue_->size() > 0)
+            return;
+        taskQueThreshold_ = std::max(1, threshold);
+        taskQue_ = std::make_unique<Queue>(taskQueThreshold_);
+    }
+
+    // 设置线程上限阈值 只有ElasticSize有上限
+    void setThreadSizeThreshold(int threshold)
+    {
+        if constexpr (SizePolicy::elastic)
+        {
+            if (checkRunningState())
+                return;
+            threadMaxSizeThreshold_ = threshold;
+        }
+    }
+
+    // 提交任务
+    template <typename Func, typename... Args>
+    auto submitTask(Func &&func, Args &&...args) -> std::future<decltype(func(args...))>
+    {
+        using RType = decltype(func(args...));
+        // 异常由packaged_task存进future，get时重新抛出；这里只负责计数和回调
+        std::packaged_task<RType()> task([this, f = std::bind(std::forward<Func>(func), std::forward<Args>(args)...)]() mutable -> RType
+                                         {
+                                             try
+                                             {
+                                                 return f();
+                                             }
+                                             catch (...)
+                                             {
+                                                 onTaskError(std::current_exception());
+                                                 throw;
+                                             } });
+        std::future<RType> res = task.get_future();
+        TaskStorage item = wrapTask(std::move(task));
+
+        // 队列满时最多等待1s
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (!taskQue_->try_push(std::move(item)))
+        {
+            auto now = std::chrono::steady_clock::now();
+            bool notFull = false;
+            if (now < deadline)
+            {
+                // 登记为等待中的提交者，工作线程只在有人等待时才通知notFull_
+                waitingProducers_++;
+                notFull = notFull_.wait_for([&]() -> bool
+                                            { return taskQue_->size() < taskQue_->capacity(); },
+                                            deadline - now);
+                waitingProducers_--;
+            }
+            if (!notFull)
+            {
+                std::cerr << "task queue is full,submit task fail." << std::endl;
+                std::packaged_task<RType()> fail([]() -> RType
+                                                 { return RType(); });
+                fail();
+                return fail.get_future();
+            }
+        }
+        notEmpty_.notify_one();
+        expandIfNeeded();
+        return res;
+    }
+
+    // 非阻塞提交 队列满直接返回false，不等待也不输出；func保持原样，调用方可以稍后重试
+    // 不关心返回值的任务用，抛出的异常只计数和回调
+    template <typename Func>
+    bool trySubmitTask(const Func &func)
+    {
+        std::packaged_task<void()> task([this, func]()
+                                        {
+                                            try
+                                            {
+                                                func();
+                                            }
+                                            catch (...)
+                                            {
+                                                onTaskError(std::current_exception());
+                                            } });
+        TaskStorage item = wrapTask(std::move(task));
+        if (!taskQue_->try_push(std::move(item)))
+            return false;
+        notEmpty_.notify_one();
+        expandIfNeeded();
+        return true;
+    }
+
+    // 设置任务异常回调 任务抛出异常时在工作线程上调用
+    using ErrorHandler = std::function<void(std::exception_ptr)>;
+    void setErrorHandler(ErrorHandler handler)
+    {
+        if (checkRunningState())
+            return;
+        errorHandler_ = std::move(handler);
+    }
+
+    // 抛出异常的任务数量
+    long failedTaskCount() const
+    {
+        return failedTaskSize_;
+    }
+
+    // 开启线程池
+    void start(int initThreadSize = std::thread::hardware_concurrency())
+    {
+        isPoolRunning_ = true;
+        initThreadSize_ = initThreadSize;
+        std::vector<Thread *> created;
+        created.reserve(initThreadSize_);
+        {
+            std::lock_guard<std::mutex> lock(threadsMtx_);
+            for (int i = 0; i < initThreadSize_; i++)
+                created.push_back(makeThread());
+        }
+        // 批量启动，不够的线程由蓄水池并行创建
+        Thread::startAll(created);
+    }
+
+    BasicThreadPool(const BasicThreadPool &) = delete;
+    BasicThreadPool &operator=(const BasicThreadPool &) = delete;
+
+private:
+    // 把packaged_task包装成存储类型：可拷贝的存储(std::function)用shared_ptr持有，只能移动的存储直接移入
+    template <typename RType>
+    static TaskStorage wrapTask(std::packaged_task<RType()> &&task)
+    {
+        if constexpr (std::is_copy_constructible<TaskStorage>::value)
+        {
+            auto sp = std::make_shared<std::packaged_task<RType()>>(std::move(task));
+            return TaskStorage([sp]()
+                               { (*sp)(); });
+        }
+        else
+        {
+            return TaskStorage([t = std::move(task)]() mutable
+                               { t(); });
+        }
+    }
+
+    // 弹性模式 任务数量多于空闲线程时扩容 启动前提交的任务留在队列里等start
+    void expandIfNeeded()
+    {
+        if constexpr (SizePolicy::elastic)
+        {
+            if (checkRunningState() && taskQue_->size() > static_cast<std::size_t>(idleThreadSize_.load()) && curThreadSize_ < threadMaxSizeThreshold_)
+            {
+                std::lock_guard<std::mutex> lock(threadsMtx_);
+                if (curThreadSize_ < threadMaxSizeThreshold_)
+                {
+                    std::cout << "cached mode triggled,create new thread." << std::endl;
+                    addThread();
+                }
+            }
+        }
+    }
+
+    // 创建并登记一个线程，还没有启动 调用方持有threadsMtx_
+    Thread *makeThread()
+    {
+        auto ptr = std::make_unique<Thread>([this](int threadId)
+                                            { threadFunc(threadId); });
+        int threadId = ptr->getId();
+        Thread *thread = ptr.get();
+        threads_.emplace(threadId, std::move(ptr));
+        curThreadSize_++;
+        if constexpr (SizePolicy::elastic)
+        {
+            idleThreadSize_++;
+        }
+        return thread;
+    }
+
+    // 创建并启动一个线程 调用方持有threadsMtx_
+    void addThread()
+    {
+        makeThread()->start();
+    }
+
+    // 定义线程函数
+    void threadFunc(int threadId)
+    {
+        auto lastTime = std::chrono::steady_clock::now();
+        auto ready = [&]() -> bool
+        { return taskQue_->size() > 0 || !isPoolRunning_; };
+        for (;;)
+        {
+            TaskStorage task;
+            if (!taskQue_->try_pop(task))
+            {
+                // 没有任务且已经析构，销毁线程
+                if (!isPoolRunning_)
+                {
+                    std::lock_guard<std::mutex> lock(threadsMtx_);
+                    threads_.erase(threadId);
+                    curThreadSize_--;
+                    if constexpr (SizePolicy::elastic)
+                    {
+                        idleThreadSize_--;
+                    }
+                    exitCond_.notify_all();
+                    return;
+                }
+                if constexpr (SizePolicy::elastic)
+                {
+                    // 每一秒返回一次，检查空闲时间
+                    if (!notEmpty_.wait_for(ready, std::chrono::seconds(1)))
+                    {
+                        auto dur = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - lastTime);
+                        if (dur.count() >= THREAD_MAX_IDLE_TIME)
+                        {
+                            std::lock_guard<std::mutex> lock(threadsMtx_);
+                            if (curThreadSize_ > initThreadSize_)
+                            {
+                                /*闲置了60s，回收当前线程*/
+                                threads_.erase(threadId);
+                                curThreadSize_--;
+                                idleThreadSize_--;
+                                return;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    notEmpty_.wait(ready);
+                }
+                continue;
+            }
+            if constexpr (WaitPolicy::needsNotify)
+            {
+                // 与提交者登记waitingProducers_后检查队列配对，保证不会漏掉通知
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (waitingProducers_.load(std::memory_order_relaxed) > 0)
+                    notFull_.notify_one();
+            }
+
+            // 空闲线程数量只有弹性模式扩容时才读，固定模式不维护
+            if constexpr (SizePolicy::elastic)
+            {
+                idleThreadSize_--;
+                task();
+                idleThreadSize_++;
+                lastTime = std::chrono::steady_clock::now();
+            }
+            else
+            {
+                task();
+            }
+        }
+    }
+
+    // 任务抛出异常：计数并调用异常回调，回调自己抛出的异常直接忽略
+    void onTaskError(std::exception_ptr ex)
+    {
+        failedTaskSize_++;
+        if (!errorHandler_)
+            return;
+        try
+        {
+            errorHandler_(ex);
+        }
+        catch (...)
+        {
+        }
+    }
+
+    // 检查pool运行状态
+    bool checkRunningState() const
+    {
+        return isPoolRunning_;
+    }
+
+private:
+    std::unordered_map<int, std::unique_ptr<Thread>> threads_; // 线程列表
+    std::mutex threadsMtx_;                                    // 保护线程列表
+    std::condition_variable exitCond_;                         // 等待线程资源回收
+    int initThreadSize_;                                       // 初始线程数量
+    int threadMaxSizeThreshold_;                               // 线程数量上限
+    std::atomic_int curThreadSize_;                            // 当前线程总数量
+
+    std::unique_ptr<Queue> taskQue_; // 任务队列，构造时创建，启动前也可以提交任务
+    int taskQueThreshold_;           // 任务队列上限阈值
+
+    WaitPolicy notEmpty_; // 任务队列不空
+    WaitPolicy notFull_;  // 任务队列不满
+
+    std::atomic_bool isPoolRunning_; // 线程池启动状态
+    ErrorHandler errorHandler_;      // 任务异常回调
+
+    alignas(CACHE_LINE_SIZE) std::atomic_int waitingProducers_; // 等待队列不满的提交者数量
+    alignas(CACHE_LINE_SIZE) std::atomic_int idleThreadSize_;   // 空闲线程数量 只在ElasticSize下维护
+    alignas(CACHE_LINE_SIZE) std::atomic_long failedTaskSize_;  // 抛出异常的任务数量 只在任务失败时写
+};
+
+// 预设：与ThreadPool默认行为一致（互斥队列、条件变量、std::function、MODE_FIXED）
+using FixedThreadPool = BasicThreadPool<MutexQueue, ParkWait, std::function<void()>, FixedSize>;
+// 预设：对应ThreadPool的MODE_CACHED
+using CachedThreadPool = BasicThreadPool<MutexQueue, ParkWait, std::function<void()>, ElasticSize>;
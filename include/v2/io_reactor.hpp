@@ -0,0 +1,539 @@
+#pragma once
+
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <unordered_set>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define IO_REACTOR_HAS_URING 1
+#else
+#define IO_REACTOR_HAS_URING 0
+#endif
+
+/**
+ * 异步I/O反应器
+ * 优先使用io_uring，由一个收割线程等待完成事件；内核不支持时退化为若干专用阻塞I/O线程
+ * （epoll无法监听普通文件，所以不用epoll做退化方案）
+ * 任何情况下都不会占用线程池的工作线程去阻塞等待I/O
+ * 用READV/WRITEV提交读写，Linux 5.1起可用；析构时取消在途请求(需要5.5)，取消不了的等它完成
+ *
+ * 返回值约定同io_uring：成功为字节数(fsync为0)，失败为-errno
+ * 回调版的回调用trySubmitTask交给线程池，线程池队列满时暂存在反应器里重试，不会丢失
+ *
+ * example:
+ * ThreadPool pool;
+ * pool.start();
+ * IoReactor<> io(pool);
+ * std::future<ssize_t> r = io.async_read(fd, buf, 4096, 0);
+ * // 完成后在线程池的工作线程上执行回调
+ * io.async_write(fd, buf, 4096, 0, [](ssize_t n) { ... });
+ */
+
+const unsigned IO_URING_ENTRIES = 256;            // io_uring提交队列深度，超出的请求在用户态排队
+const int IO_FALLBACK_THREAD_SIZE = 4;            // 退化模式的阻塞I/O线程数量
+const int IO_RETRY_INTERVAL = 1;                  // 内核或线程池暂时不收时的重试间隔，单位：毫秒
+const unsigned long long IO_CANCEL_USER_DATA = 1; // 取消请求的user_data，和Op指针区分
+
+template <typename Pool = ThreadPool>
+class IoReactor
+{
+public:
+    using Callback = std::function<void(ssize_t)>;
+
+    IoReactor(Pool &pool, unsigned entries = IO_URING_ENTRIES)
+        : pool_(pool), isRunning_(true), ringFd_(-1), eventFd_(-1), inflight_(0)
+    {
+        if (!setupRing(entries))
+        {
+            // 退化为专用阻塞I/O线程
+            for (int i = 0; i < IO_FALLBACK_THREAD_SIZE; i++)
+                workers_.emplace_back(&IoReactor::blockingFunc, this);
+            return;
+        }
+        workers_.emplace_back(&IoReactor::reapFunc, this);
+    }
+    ~IoReactor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            isRunning_ = false;
+            // 取消在途请求，收割线程等它们全部完成后退出
+            if (ringFd_ >= 0)
+                cancelInflight();
+        }
+        wakeReaper();
+        pendingCond_.notify_all();
+        for (std::thread &t : workers_)
+            t.join();
+        // 退出后仍未提交的请求按被取消处理
+        for (Op *op : pending_)
+            finish(op, -ECANCELED);
+        // 剩下的回调全部交给线程池
+        while (!dispatchContinuations())
+            std::this_thread::sleep_for(std::chrono::milliseconds(IO_RETRY_INTERVAL));
+        teardownRing();
+    }
+
+    IoReactor(const IoReactor &) = delete;
+    IoReactor &operator=(const IoReactor &) = delete;
+
+    // future版：结果由反应器线程直接写入，调用方get()时拿到
+    std::future<ssize_t> async_read(int fd, void *buf, size_t len, off_t offset)
+    {
+        return submitFuture(OpRead, fd, buf, len, offset);
+    }
+    std::future<ssize_t> async_write(int fd, const void *buf, size_t len, off_t offset)
+    {
+        return submitFuture(OpWrite, fd, const_cast<void *>(buf), len, offset);
+    }
+    std::future<ssize_t> async_fsync(int fd)
+    {
+        return submitFuture(OpFsync, fd, nullptr, 0, 0);
+    }
+
+    // 回调版：完成后把回调提交到线程池，在工作线程上继续执行
+    void async_read(int fd, void *buf, size_t len, off_t offset, Callback cb)
+    {
+        submitCallback(OpRead, fd, buf, len, offset, std::move(cb));
+    }
+    void async_write(int fd, const void *buf, size_t len, off_t offset, Callback cb)
+    {
+        submitCallback(OpWrite, fd, const_cast<void *>(buf), len, offset, std::move(cb));
+    }
+    void async_fsync(int fd, Callback cb)
+    {
+        submitCallback(OpFsync, fd, nullptr, 0, 0, std::move(cb));
+    }
+
+    // 是否使用io_uring
+    bool usingUring() const
+    {
+        return ringFd_ >= 0;
+    }
+
+private:
+    enum OpType
+    {
+        OpRead,
+        OpWrite,
+        OpFsync,
+    };
+
+    // 一次I/O请求
+    struct Op
+    {
+        OpType type;
+        int fd;
+        void *buf;
+        size_t len;
+        off_t offset;
+        std::function<void(ssize_t)> done; // 完成通知，在反应器线程上调用
+        iovec iov;                         // READV/WRITEV的缓冲区描述，长度不受sqe的32位len限制
+        bool cancelled;                    // 是否已提交过取消
+    };
+
+    std::future<ssize_t> submitFuture(OpType type, int fd, void *buf, size_t len, off_t offset)
+    {
+        auto promise = std::make_shared<std::promise<ssize_t>>();
+        std::future<ssize_t> res = promise->get_future();
+        submit(new Op{type, fd, buf, len, offset, [promise](ssize_t n)
+                      { promise->set_value(n); },
+                      {}, false});
+        return res;
+    }
+
+    void submitCallback(OpType type, int fd, void *buf, size_t len, off_t offset, Callback cb)
+    {
+        submit(new Op{type, fd, buf, len, offset, [this, cb = std::move(cb)](ssize_t n)
+                      { dispatch([cb, n]()
+                                 { cb(n); }); },
+                      {}, false});
+    }
+
+    // 把回调交给线程池 队列满时暂存，由反应器线程稍后重试，不阻塞调用方
+    void dispatch(std::function<void()> job)
+    {
+        std::lock_guard<std::mutex> lock(contMtx_);
+        // 前面还有暂存的回调时排到后面，保持完成顺序
+        if (continuations_.empty() && pool_.trySubmitTask(job))
+            return;
+        continuations_.push_back(std::move(job));
+    }
+
+    // 重试暂存的回调 全部交出返回true
+    bool dispatchContinuations()
+    {
+        std::lock_guard<std::mutex> lock(contMtx_);
+        while (!continuations_.empty())
+        {
+            if (!pool_.trySubmitTask(continuations_.front()))
+                return false;
+            continuations_.pop_front();
+        }
+        return true;
+    }
+
+    bool hasContinuations()
+    {
+        std::lock_guard<std::mutex> lock(contMtx_);
+        return !continuations_.empty();
+    }
+
+    void submit(Op *op)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!isRunning_)
+        {
+            lock.unlock();
+            finish(op, -ECANCELED);
+            return;
+        }
+        pending_.push_back(op);
+        if (ringFd_ >= 0)
+        {
+            flushPending();
+            // 内核暂时没收下，交给收割线程重试
+            if (sqPending() > 0)
+                wakeReaper();
+        }
+        else
+        {
+            pendingCond_.notify_one();
+        }
+    }
+
+    static void finish(Op *op, ssize_t res)
+    {
+        op->done(res);
+        delete op;
+    }
+
+    /**
+     * 退化模式：专用线程执行阻塞调用
+     */
+    void blockingFunc()
+    {
+        for (;;)
+        {
+            Op *op = nullptr;
+            bool drained = dispatchContinuations();
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                auto ready = [&]() -> bool
+                { return !pending_.empty() || !isRunning_; };
+                // 有暂存的回调时定时醒来重试
+                if (drained)
+                    pendingCond_.wait(lock, ready);
+                else
+                    pendingCond_.wait_for(lock, std::chrono::milliseconds(IO_RETRY_INTERVAL), ready);
+                if (pending_.empty())
+                {
+                    // 退出后剩下的回调由析构函数交出
+                    if (!isRunning_)
+                        return;
+                    continue;
+                }
+                op = pending_.front();
+                pending_.pop_front();
+            }
+            ssize_t res = 0;
+            switch (op->type)
+            {
+            case OpRead:
+                res = ::pread(op->fd, op->buf, op->len, op->offset);
+                break;
+            case OpWrite:
+                res = ::pwrite(op->fd, op->buf, op->len, op->offset);
+                break;
+            case OpFsync:
+                res = ::fsync(op->fd);
+                break;
+            }
+            finish(op, res < 0 ? -errno : res);
+        }
+    }
+
+#if IO_REACTOR_HAS_URING
+    /**
+     * io_uring模式
+     */
+    bool setupRing(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+            return false;
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap)
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+        sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        cqRing_ = singleMmap ? sqRing_ : ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe *>(::mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED)
+        {
+            if (cqRing_ != MAP_FAILED && !singleMmap)
+                ::munmap(cqRing_, cqRingSize_);
+            ::munmap(sqRing_, sqRingSize_);
+            ::close(fd);
+            return false;
+        }
+
+        char *sq = static_cast<char *>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        char *cq = static_cast<char *>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        sqEntries_ = params.sq_entries;
+        singleMmap_ = singleMmap;
+        ringFd_ = fd;
+
+        // 完成事件通过eventfd通知收割线程，用户态也能写它来唤醒收割线程 需要Linux 5.2
+        eventFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (eventFd_ < 0 || ::syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_EVENTFD, &eventFd_, 1) < 0)
+        {
+            teardownRing();
+            return false;
+        }
+        return true;
+    }
+
+    void teardownRing()
+    {
+        if (ringFd_ < 0)
+            return;
+        ::munmap(sqes_, sqEntries_ * sizeof(io_uring_sqe));
+        if (!singleMmap_)
+            ::munmap(cqRing_, cqRingSize_);
+        ::munmap(sqRing_, sqRingSize_);
+        ::close(ringFd_);
+        if (eventFd_ >= 0)
+            ::close(eventFd_);
+        ringFd_ = -1;
+        eventFd_ = -1;
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    // 唤醒收割线程
+    void wakeReaper()
+    {
+        if (eventFd_ < 0)
+            return;
+        uint64_t one = 1;
+        ssize_t n = ::write(eventFd_, &one, sizeof(one));
+        (void)n;
+    }
+
+    // 提交队列里内核还没取走的sqe数量 调用方持有mtx_
+    unsigned sqPending()
+    {
+        return *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    }
+
+    // 填一个sqe 调用方持有mtx_，并保证提交队列有空位
+    io_uring_sqe *pushSqe(int opcode, int fd, unsigned long long userData)
+    {
+        unsigned tail = *sqTail_;
+        unsigned index = tail & sqMask_;
+        io_uring_sqe *sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = static_cast<__u8>(opcode);
+        sqe->fd = fd;
+        sqe->user_data = userData;
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    // 把提交队列里的sqe交给内核 调用方持有mtx_
+    // 内核暂时不收(EAGAIN/EBUSY)时sqe留在队列里，由收割线程定时重试
+    void submitSqes()
+    {
+        unsigned left;
+        while ((left = sqPending()) > 0)
+        {
+            int ret = enter(left, 0, 0);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                return;
+        }
+    }
+
+    // 把排队的请求写入提交队列 在途数量(含还没交给内核的)不超过环大小，保证完成队列不溢出 调用方持有mtx_
+    void flushPending()
+    {
+        while (!pending_.empty() && inflight_ < sqEntries_)
+        {
+            Op *op = pending_.front();
+            pending_.pop_front();
+            if (op->type == OpFsync)
+            {
+                pushSqe(IORING_OP_FSYNC, op->fd, reinterpret_cast<unsigned long long>(op));
+            }
+            else
+            {
+                op->iov.iov_base = op->buf;
+                op->iov.iov_len = op->len;
+                io_uring_sqe *sqe = pushSqe(op->type == OpRead ? IORING_OP_READV : IORING_OP_WRITEV, op->fd, reinterpret_cast<unsigned long long>(op));
+                sqe->addr = reinterpret_cast<unsigned long long>(&op->iov);
+                sqe->len = 1;
+                sqe->off = static_cast<unsigned long long>(op->offset);
+            }
+            submitted_.insert(op);
+            inflight_++;
+        }
+        submitSqes();
+    }
+
+    // 为还没取消过的在途请求提交取消 提交队列满时剩下的留到下次 调用方持有mtx_
+    void cancelInflight()
+    {
+        for (Op *op : submitted_)
+        {
+            if (sqPending() >= sqEntries_)
+                break;
+            if (op->cancelled)
+                continue;
+            op->cancelled = true;
+            io_uring_sqe *sqe = pushSqe(IORING_OP_ASYNC_CANCEL, -1, IO_CANCEL_USER_DATA);
+            sqe->addr = reinterpret_cast<unsigned long long>(op);
+        }
+        submitSqes();
+    }
+
+    // 收割线程：等待完成事件，结束对应请求
+    void reapFunc()
+    {
+        std::vector<std::pair<Op *, ssize_t>> done;
+        for (;;)
+        {
+            // 有没交给内核的sqe或暂存的回调时定时醒来重试，否则一直等到完成事件或唤醒
+            bool retry;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                retry = sqPending() > 0;
+            }
+            retry = retry || hasContinuations();
+            pollfd pfd{eventFd_, POLLIN, 0};
+            ::poll(&pfd, 1, retry ? IO_RETRY_INTERVAL : -1);
+            // 先清空计数再收割，之后到达的完成事件会再次触发
+            uint64_t value;
+            ssize_t n = ::read(eventFd_, &value, sizeof(value));
+            (void)n;
+
+            unsigned head = *cqHead_;
+            while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+            {
+                io_uring_cqe *cqe = &cqes_[head & cqMask_];
+                // 取消请求自己的完成事件不用处理
+                if (cqe->user_data != IO_CANCEL_USER_DATA)
+                    done.emplace_back(reinterpret_cast<Op *>(cqe->user_data), cqe->res);
+                head++;
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+            bool stop;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                inflight_ -= static_cast<unsigned>(done.size());
+                // 先移出在途集合再结束请求，Op释放后地址被复用也不会认错
+                for (auto &d : done)
+                    submitted_.erase(d.first);
+                if (isRunning_)
+                    flushPending();
+                else
+                    cancelInflight();
+                submitSqes();
+                // 析构已开始且在途请求全部完成才退出 状态记在isRunning_里，不会因为一轮没收完而丢失
+                stop = !isRunning_ && inflight_ == 0;
+            }
+            for (auto &d : done)
+                finish(d.first, d.second);
+            done.clear();
+            dispatchContinuations();
+            if (stop)
+                return;
+        }
+    }
+#else
+    bool setupRing(unsigned)
+    {
+        return false;
+    }
+    void teardownRing() {}
+    void wakeReaper() {}
+    unsigned sqPending()
+    {
+        return 0;
+    }
+    void flushPending() {}
+    void cancelInflight() {}
+    void reapFunc() {}
+#endif
+
+private:
+    Pool &pool_;
+    std::mutex mtx_;                      // 保护提交队列、排队请求
+    std::condition_variable pendingCond_; // 退化模式下通知I/O线程
+    std::deque<Op *> pending_;            // 等待提交的请求
+    std::vector<std::thread> workers_;    // 收割线程或阻塞I/O线程
+    bool isRunning_;                      // 反应器运行状态
+
+    std::mutex contMtx_;                              // 保护暂存的回调
+    std::deque<std::function<void()>> continuations_; // 线程池队列满时暂存的回调
+
+    int ringFd_;        // io_uring文件描述符 -1表示退化模式
+    int eventFd_;       // 完成事件通知
+    unsigned inflight_; // 已写入提交队列未完成的请求数量
+#if IO_REACTOR_HAS_URING
+    std::unordered_set<Op *> submitted_; // 在途请求，析构时逐个取消
+    void *sqRing_ = nullptr;
+    void *cqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    bool singleMmap_ = false;
+    unsigned sqEntries_ = 0;
+    unsigned *sqHead_ = nullptr;
+    unsigned *sqTail_ = nullptr;
+    unsigned *sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    unsigned *cqHead_ = nullptr;
+    unsigned *cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+#endif
+};
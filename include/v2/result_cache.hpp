@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * 合并提交(single-flight)用到的并发容器
+ * 按key哈希分片，每个分片一把锁，不同key的访问基本不会互相竞争
+ */
+
+const int CACHE_SHARD_SIZE = 16;   // 分片数量
+const size_t CACHE_LINE_SIZE = 64; // 缓存行大小，隔离多线程频繁写的数据
+
+// 分片哈希表
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ShardedMap
+{
+public:
+    // key已存在返回{已有值, false}，否则插入make()的结果并返回{新值, true}
+    template <typename Make>
+    std::pair<V, bool> findOrInsert(const K &key, Make make)
+    {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        auto it = s.map.find(key);
+        if (it != s.map.end())
+            return {it->second, false};
+        auto res = s.map.emplace(key, make());
+        return {res.first->second, true};
+    }
+
+    void erase(const K &key)
+    {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.map.erase(key);
+    }
+
+private:
+    // 分片独占缓存行，避免相邻分片的锁互相干扰
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::mutex mtx;
+        std::unordered_map<K, V, Hash> map;
+    };
+
+    Shard &shard(const K &key)
+    {
+        return shards_[Hash()(key) % CACHE_SHARD_SIZE];
+    }
+
+private:
+    std::array<Shard, CACHE_SHARD_SIZE> shards_;
+};
+
+// 有界LRU结果缓存，可选TTL过期 容量是所有分片的总和
+// 容量小于分片数时只用capacity个分片，每个分片至少1项；容量为0时不缓存
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LruCache
+{
+public:
+    // ttl为0表示不过期
+    LruCache(size_t capacity, std::chrono::milliseconds ttl = std::chrono::milliseconds(0))
+        : ttl_(ttl), shardSize_(std::min<size_t>(capacity, CACHE_SHARD_SIZE))
+    {
+        // 余数分给前几个分片，总和正好是capacity
+        for (size_t i = 0; i < shardSize_; i++)
+            shards_[i].capacity = capacity / shardSize_ + (i < capacity % shardSize_ ? 1 : 0);
+    }
+
+    // 命中返回true并把value写入out，同时移到LRU头部；过期项直接删除
+    bool get(const K &key, V &out)
+    {
+        if (shardSize_ == 0)
+            return false;
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        auto it = s.index.find(key);
+        if (it == s.index.end())
+            return false;
+        if (ttl_.count() > 0 && std::chrono::steady_clock::now() >= it->second->expire)
+        {
+            s.lru.erase(it->second);
+            s.index.erase(it);
+            return false;
+        }
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        out = it->second->value;
+        return true;
+    }
+
+    void put(const K &key, V value)
+    {
+        if (shardSize_ == 0)
+            return;
+        Shard &s = shard(key);
+        auto expire = std::chrono::steady_clock::now() + ttl_;
+        std::lock_guard<std::mutex> lock(s.mtx);
+        auto it = s.index.find(key);
+        if (it != s.index.end())
+        {
+            it->second->value = std::move(value);
+            it->second->expire = expire;
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return;
+        }
+        // 满了淘汰最久未使用的
+        if (s.lru.size() >= s.capacity)
+        {
+            s.index.erase(s.lru.back().key);
+            s.lru.pop_back();
+        }
+        s.lru.push_front(Entry{key, std::move(value), expire});
+        s.index.emplace(key, s.lru.begin());
+    }
+
+    void erase(const K &key)
+    {
+        if (shardSize_ == 0)
+            return;
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        auto it = s.index.find(key);
+        if (it == s.index.end())
+            return;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+    }
+
+private:
+    struct Entry
+    {
+        K key;
+        V value;
+        std::chrono::steady_clock::time_point expire; // 过期时间点
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::mutex mtx;
+        std::list<Entry> lru; // 头部最近使用
+        std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+        size_t capacity = 0;
+    };
+
+    Shard &shard(const K &key)
+    {
+        return shards_[Hash()(key) % shardSize_];
+    }
+
+private:
+    std::chrono::milliseconds ttl_;
+    size_t shardSize_; // 实际使用的分片数量
+    std::array<Shard, CACHE_SHARD_SIZE> shards_;
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <alloca.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/**
+ * 进程级线程蓄水池
+ * 线程函数返回后线程不退出，停放在这里等待下一个任务；新建的线程池直接租用停放的线程，
+ * 省掉每次创建、销毁系统线程的开销。停放超时或超过停放上限的线程才真正退出
+ *
+ * example:
+ * ThreadReservoir::instance().setPrefault(256 * 1024, [] { initThreadLocal(); });
+ * ThreadReservoir::instance().prewarm(16);
+ */
+
+const int RESERVOIR_MAX_PARKED = 256;    // 最多停放的线程数量
+const int RESERVOIR_MAX_PARKED_TIME = 60; // 停放超时，单位：秒
+
+class ThreadReservoir
+{
+public:
+    using Job = std::function<void()>;
+
+    // 全局唯一 故意不析构：停放的线程可能在进程退出时仍在等待
+    static ThreadReservoir &instance()
+    {
+        static ThreadReservoir *reservoir = new ThreadReservoir();
+        return *reservoir;
+    }
+
+    // 预先创建n个线程并停放
+    void prewarm(int threadSize)
+    {
+        if (threadSize <= 0)
+            return;
+        std::vector<Job> jobs(threadSize);
+        spawn(std::make_shared<std::vector<Job>>(std::move(jobs)), 0, threadSize);
+    }
+
+    // 新线程启动时预先触碰的栈大小(0为关闭)，以及初始化线程局部变量的回调
+    // 只对之后新建的线程生效
+    void setPrefault(size_t stackBytes, Job threadInit = nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        prefaultStackBytes_ = stackBytes;
+        threadInit_ = std::move(threadInit);
+    }
+
+    // 设置最多停放的线程数量
+    void setMaxParked(int threshold)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        maxParkedSize_ = threshold;
+    }
+
+    // 当前停放的线程数量
+    int parkedSize()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return static_cast<int>(parked_.size());
+    }
+
+    // 执行一个任务：有停放的线程直接交给它，没有则新建
+    void run(Job job)
+    {
+        std::vector<Job> jobs;
+        jobs.emplace_back(std::move(job));
+        run(std::move(jobs));
+    }
+
+    // 批量执行：一次加锁分配停放的线程，剩下的并行创建
+    void run(std::vector<Job> jobs)
+    {
+        size_t begin = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            while (begin < jobs.size() && !parked_.empty())
+            {
+                Parked *p = parked_.back();
+                parked_.pop_back();
+                p->job = std::move(jobs[begin++]);
+                p->cond.notify_one();
+            }
+        }
+        size_t end = jobs.size();
+        if (begin < end)
+            spawn(std::make_shared<std::vector<Job>>(std::move(jobs)), begin, end);
+    }
+
+    ThreadReservoir(const ThreadReservoir &) = delete;
+    ThreadReservoir &operator=(const ThreadReservoir &) = delete;
+
+private:
+    ThreadReservoir() : maxParkedSize_(RESERVOIR_MAX_PARKED), prefaultStackBytes_(0) {}
+
+    // 停放中的线程 每个线程一个，任务直接交到指定线程手里
+    struct Parked
+    {
+        Job job;
+        std::condition_variable cond;
+    };
+
+    // 为[begin, end)的任务创建线程：新线程先把后一半交给另一个新线程再执行自己的，
+    // 调用方只创建一个线程就返回，n个线程的启动深度为log(n)
+    // 调用方创建失败时异常抛给调用方；新线程里再创建失败时不能抛出(会终止进程)，
+    // 没交出去的任务留在当前线程上依次执行
+    void spawn(std::shared_ptr<std::vector<Job>> jobs, size_t begin, size_t end)
+    {
+        std::thread t([this, jobs, begin, end]() mutable
+                      {
+                          while (end - begin > 1)
+                          {
+                              size_t mid = begin + (end - begin) / 2;
+                              try
+                              {
+                                  spawn(jobs, mid, end);
+                              }
+                              catch (const std::system_error &)
+                              {
+                                  // 系统线程耗尽(EAGAIN)
+                                  break;
+                              }
+                              end = mid;
+                          }
+                          Job job;
+                          if (end - begin == 1)
+                          {
+                              job = std::move((*jobs)[begin]);
+                          }
+                          else
+                          {
+                              auto rest = std::make_shared<std::vector<Job>>(std::make_move_iterator(jobs->begin() + begin),
+                                                                             std::make_move_iterator(jobs->begin() + end));
+                              job = [rest]()
+                              {
+                                  for (Job &j : *rest)
+                                  {
+                                      j();
+                                      j = nullptr;
+                                  }
+                              };
+                          }
+                          jobs.reset();
+                          threadFunc(std::move(job)); });
+        t.detach();
+    }
+
+    // 蓄水池线程函数：执行任务，完成后停放等待下一个
+    void threadFunc(Job job)
+    {
+        size_t stackBytes;
+        Job threadInit;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stackBytes = prefaultStackBytes_;
+            threadInit = threadInit_;
+        }
+        if (stackBytes > 0)
+            prefaultStack(stackBytes);
+        if (threadInit)
+            threadInit();
+
+        Parked self;
+        for (;;)
+        {
+            if (job)
+            {
+                job();
+                // 先释放任务持有的资源再停放
+                job = nullptr;
+            }
+            std::unique_lock<std::mutex> lock(mtx_);
+            if (static_cast<int>(parked_.size()) >= maxParkedSize_)
+                return;
+            parked_.push_back(&self);
+            if (!self.cond.wait_for(lock, std::chrono::seconds(RESERVOIR_MAX_PARKED_TIME), [&]() -> bool
+                                    { return static_cast<bool>(self.job); }))
+            {
+                // 停放超时，退出
+                parked_.erase(std::find(parked_.begin(), parked_.end(), &self));
+                return;
+            }
+            job = std::move(self.job);
+            self.job = nullptr;
+        }
+    }
+
+    // 逐页写一遍栈，提前触发缺页 不能内联，否则alloca的空间留在调用方栈帧里
+    __attribute__((noinline)) static void prefaultStack(size_t bytes)
+    {
+        volatile char *stack = static_cast<volatile char *>(alloca(bytes));
+        for (size_t i = 0; i < bytes; i += 4096)
+            stack[i] = 0;
+    }
+
+private:
+    std::mutex mtx_;
+    std::vector<Parked *> parked_; // 停放的线程 后进先出，优先复用刚停下、缓存还热的线程
+    int maxParkedSize_;            // 最多停放的线程数量
+    size_t prefaultStackBytes_;    // 预触碰栈大小
+    Job threadInit_;               // 新线程初始化回调
+};
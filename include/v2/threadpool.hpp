@@ -1,5 +1,6 @@
-#pragma
+#pragma once
 
+#include <algorithm>
 #include <vector>
 #include <queue>
 #include <memory>
@@ -11,6 +12,12 @@
 #include <iostream>
 #include <unordered_map>
 #include <future>
+#include <exception>
+#include <any>
+#include <optional>
+#include <string>
+#include "result_cache.hpp"
+#include "thread_reservoir.hpp"
 
 /**
  * package-task future版
@@ -33,17 +40,25 @@ class Thread
 public:
     // 通用函数类型，接受一个无参数且无返回值的函数
     using ThreadFunc = std::function<void(int)>;
-    Thread(ThreadFunc func) : func_(func), threadId_(genId_++)
+    Thread(ThreadFunc func) : func_(std::move(func)), threadId_(genId_++)
     {
     }
     ~Thread() = default;
 
-    // 启动线程
+    // 启动线程 从线程蓄水池租用停放的线程执行线程函数，没有停放的再新建
     void start()
     {
-        // 创建一个线程来执行一个线程函数
-        std::thread t(func_, threadId_); // c++11来说 线程对象t 和线程函数func
-        t.detach();                      // 设置分离线程
+        ThreadReservoir::instance().run(job());
+    }
+
+    // 批量启动线程 一次分配停放的线程，不够的并行创建
+    static void startAll(const std::vector<Thread *> &threads)
+    {
+        std::vector<ThreadReservoir::Job> jobs;
+        jobs.reserve(threads.size());
+        for (Thread *thread : threads)
+            jobs.emplace_back(thread->job());
+        ThreadReservoir::instance().run(std::move(jobs));
     }
 
     // 获取线程id
@@ -52,25 +67,33 @@ public:
         return threadId_;
     }
 
+private:
+    // 线程函数拷贝一份交给线程，Thread对象在线程运行期间被删除也不影响
+    ThreadReservoir::Job job() const
+    {
+        return [func = func_, threadId = threadId_]()
+        { func(threadId); };
+    }
+
 private:
     ThreadFunc func_;
-    static int genId_;
-    int threadId_; // 线程id
+    inline static std::atomic_int genId_{0}; // 多个线程池并发创建线程，id必须原子递增
+    int threadId_;                           // 线程id
 };
-int Thread::genId_ = 0;
 
 // 线程池类型
 class ThreadPool
 {
 public:
     ThreadPool() : initThreadSize_(0),
-                   taskSize_(0),
+                   threadMaxSizeThreshold_(THREAD_MAX_THRESHOLD),
                    taskQueThreshold_(TASK_MAX_THRESHOLD),
                    poolMode_(PoolMode::MODE_FIXED),
                    isPoolRunning_(false),
-                   idleThreadSize_(0),
-                   threadMaxSizeThreshold_(THREAD_MAX_THRESHOLD),
-                   curThreadSize_(0)
+                   curThreadSize_(0),
+                   retireThreadSize_(0),
+                   taskSize_(0),
+                   failedTaskSize_(0)
     {
     }
     ~ThreadPool()
@@ -110,47 +133,177 @@ public:
         }
     }
 
+    /**
+     * 运行期调整 线程池运行中也可以调用，不会停下整个池子
+     * 减少线程时只让多出来的线程在取下一个任务前退出，队列里的任务不会丢失，也不会乱序
+     */
+
+    // 调整核心线程数量 fixed模式即线程总数，cached模式为空闲回收的下限
+    void resize(int threadSize)
+    {
+        if (!checkRunningState())
+            return;
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        threadSize = std::max(1, std::min(threadSize, threadMaxSizeThreshold_));
+        initThreadSize_ = threadSize;
+        int liveThreadSize = curThreadSize_ - retireThreadSize_;
+        if (liveThreadSize < threadSize)
+        {
+            // 先撤销还没执行的回收，不够再创建新线程
+            int cancel = std::min(retireThreadSize_, threadSize - liveThreadSize);
+            retireThreadSize_ -= cancel;
+            for (liveThreadSize += cancel; liveThreadSize < threadSize; liveThreadSize++)
+            {
+                addThread();
+            }
+        }
+        else if (liveThreadSize > threadSize)
+        {
+            retireThreadSize_ += liveThreadSize - threadSize;
+            // 唤醒空闲线程，让它们检查是否需要退出
+            notEmpty_.notify_all();
+        }
+    }
+
+    // 调整任务队列上限 至少为1，已在队列里的任务保持不变
+    void setQueueCapacity(int capacity)
+    {
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        taskQueThreshold_ = std::max(1, capacity);
+        // 上限变大，唤醒等待的提交者
+        notFull_.notify_all();
+    }
+
+    // 调整线程数量上限 当前线程超出上限时，多出的线程执行完手头任务后退出
+    void setMaxThreads(int threshold)
+    {
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        threadMaxSizeThreshold_ = std::max(1, threshold);
+        if (initThreadSize_ > threadMaxSizeThreshold_)
+            initThreadSize_ = threadMaxSizeThreshold_;
+        int liveThreadSize = curThreadSize_ - retireThreadSize_;
+        if (checkRunningState() && liveThreadSize > threadMaxSizeThreshold_)
+        {
+            retireThreadSize_ += liveThreadSize - threadMaxSizeThreshold_;
+            notEmpty_.notify_all();
+        }
+    }
+
     // 提交任务 模板参数
     template <typename Func, typename... Args>
     auto submitTask(Func &&func, Args &&...args) -> std::future<decltype(func(args...))>
     {
         using RType = decltype(func(args...));
-        auto task = std::make_shared<std::packaged_task<RType()>>(std::bind(std::forward<Func>(func), std::forward<Args>(args)...));
+        // 异常由packaged_task存进future，get时重新抛出；这里只负责计数和回调
+        auto task = std::make_shared<std::packaged_task<RType()>>([this, f = std::bind(std::forward<Func>(func), std::forward<Args>(args)...)]() mutable -> RType
+                                                                  {
+                                                                      try
+                                                                      {
+                                                                          return f();
+                                                                      }
+                                                                      catch (...)
+                                                                      {
+                                                                          onTaskError(std::current_exception());
+                                                                          throw;
+                                                                      } });
         std::future<RType> res = task->get_future();
-        // 获取锁
-        std::unique_lock<std::mutex> lock(taskQueMtx_);
-        if (!notFull_.wait_for(lock, std::chrono::seconds(1), [&]() -> bool
-                               { return taskQue_.size() < taskQueThreshold_; }))
+        if (!pushTask([task]()
+                      { (*task)(); }))
         {
-            // 等待1s后，条件依然没有满足-队列还是慢的 输出到标准输出
-            std::cerr << "task queue is full,submit task fail." << std::endl;
             auto task = std::make_shared<std::packaged_task<RType()>>([]() -> RType
                                                                       { return RType(); });
             (*task)();
             return task->get_future();
         }
-        // 有空余，加入等待队列
-        taskQue_.emplace([task]()
-                         { (*task)(); });
-        taskSize_++;
-        // 此时队列不空，在notEmpty上通知
-        notEmpty_.notify_all();
-        // cached模式 任务处理比较紧急 场景：小而快的任务 需要根据任务数量和空闲线程的数量，判断是否需要扩容
-        if (poolMode_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ && curThreadSize_ < threadMaxSizeThreshold_)
+        // 返回任务result对象
+        return res;
+    }
+
+    // 非阻塞提交 队列满直接返回false，不等待也不输出；func保持原样，调用方可以稍后重试
+    // 不关心返回值的任务用，抛出的异常只计数和回调
+    template <typename Func>
+    bool trySubmitTask(const Func &func)
+    {
+        return pushTask(Task(func), false);
+    }
+
+    // 设置任务异常回调 任务抛出异常时在工作线程上调用
+    using ErrorHandler = std::function<void(std::exception_ptr)>;
+    void setErrorHandler(ErrorHandler handler)
+    {
+        if (checkRunningState())
+            return;
+        errorHandler_ = std::move(handler);
+    }
+
+    // 抛出异常的任务数量
+    long failedTaskCount() const
+    {
+        return failedTaskSize_;
+    }
+
+    // 开启结果缓存 最多缓存capacity个结果，为0时关闭；ttl为0表示不过期
+    void setResultCache(size_t capacity, std::chrono::milliseconds ttl = std::chrono::milliseconds(0))
+    {
+        if (checkRunningState())
+            return;
+        if (capacity == 0)
         {
-            std::cout << "cached mode triggled,create new thread." << std::endl;
-            // 创建新线程
-            auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-            int threadId = ptr->getId();
-            // unique_ptr不允许右值拷贝 move移动语义
-            threads_.emplace(threadId, std::move(ptr));
-            // 启动线程
-            threads_[threadId]->start();
-            // 修改线程个数变量
-            curThreadSize_++;
-            idleThreadSize_++;
+            resultCache_.reset();
+            return;
+        }
+        resultCache_ = std::make_unique<LruCache<std::string, std::any>>(capacity, ttl);
+    }
+
+    /**
+     * 合并提交：同一个key的任务在排队或执行期间，后来的提交者直接共享它的结果，不再重复入队
+     * 开启结果缓存时，成功的结果按key缓存，命中直接返回
+     * 同一个key必须对应同一种返回值类型，否则抛出std::bad_any_cast
+     */
+    template <typename Func>
+    auto submitCoalesced(const std::string &key, Func &&func) -> std::shared_future<decltype(func())>
+    {
+        using RType = decltype(func());
+        static_assert(!std::is_void<RType>::value, "coalesced task must return a value");
+        std::any cached;
+        if (resultCache_ && resultCache_->get(key, cached))
+            return std::any_cast<std::shared_future<RType>>(cached);
+
+        auto promise = std::make_shared<std::promise<RType>>();
+        auto found = inflight_.findOrInsert(key, [&]() -> std::any
+                                            { return std::shared_future<RType>(promise->get_future()); });
+        std::shared_future<RType> res = std::any_cast<std::shared_future<RType>>(found.first);
+        // 已有相同任务在途
+        if (!found.second)
+            return res;
+
+        bool ok = pushTask([this, key, promise, res, func = std::forward<Func>(func)]() mutable
+                           {
+                               std::exception_ptr error;
+                               std::optional<RType> value;
+                               try
+                               {
+                                   value.emplace(func());
+                               }
+                               catch (...)
+                               {
+                                   error = std::current_exception();
+                                   onTaskError(error);
+                               }
+                               // 先写缓存再移出在途表，中间不会出现两边都查不到的窗口
+                               if (!error && resultCache_)
+                                   resultCache_->put(key, res);
+                               inflight_.erase(key);
+                               // 最后才让等待者拿到结果，get返回后再提交看到的一定是缓存或新任务
+                               if (error)
+                                   promise->set_exception(error);
+                               else
+                                   promise->set_value(std::move(*value)); });
+        if (!ok)
+        {
+            inflight_.erase(key);
+            promise->set_value(RType());
         }
-        // 返回任务result对象
         return res;
     }
 
@@ -163,22 +316,19 @@ public:
         initThreadSize_ = initThreadSize;
         curThreadSize_ = initThreadSize;
         // 创建线程对象
+        std::vector<Thread *> created;
+        created.reserve(initThreadSize_);
         for (int i = 0; i < initThreadSize_; i++)
         {
             // 创建线程对象，把线程函数给到thread对象
-            // move移动
-            auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-            int threadId = ptr->getId();
+            auto ptr = makeThread();
+            created.push_back(ptr.get());
             // unique_ptr不允许右值拷贝 move移动语义
-            threads_.emplace(threadId, std::move(ptr));
+            threads_.emplace(ptr->getId(), std::move(ptr));
         }
 
-        // 启动所有线程
-        for (int i = 0; i < initThreadSize_; i++)
-        {
-            threads_[i]->start();
-            idleThreadSize_++; // 记录初始空闲线程数量
-        }
+        // 启动所有线程 线程id在多个线程池间全局递增，不能按下标取
+        Thread::startAll(created);
     }
 
     // 禁止对象构造
@@ -187,10 +337,98 @@ public:
     ThreadPool &operator=(const ThreadPool &) = delete;
 
 private:
+    using Task = std::function<void()>;
+
+    // 任务入队 队列满等待1s仍失败返回false；wait为false时不等待
+    bool pushTask(Task task, bool wait = true)
+    {
+        // 获取锁
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        auto notFull = [&]() -> bool
+        { return taskQue_.size() < taskQueThreshold_; };
+        if (!wait)
+        {
+            if (!notFull())
+                return false;
+        }
+        else if (!notFull_.wait_for(lock, std::chrono::seconds(1), notFull))
+        {
+            // 等待1s后，条件依然没有满足-队列还是慢的 输出到标准输出
+            std::cerr << "task queue is full,submit task fail." << std::endl;
+            return false;
+        }
+        // 有空余，加入等待队列
+        taskQue_.emplace(std::move(task));
+        taskSize_++;
+        // 此时队列不空，在notEmpty上通知
+        notEmpty_.notify_all();
+        // cached模式 任务处理比较紧急 场景：小而快的任务 需要根据任务数量和空闲线程的数量，判断是否需要扩容
+        if (poolMode_ == PoolMode::MODE_CACHED && curThreadSize_ < threadMaxSizeThreshold_ && taskSize_ > idleThreadSize())
+        {
+            std::cout << "cached mode triggled,create new thread." << std::endl;
+            addThread();
+        }
+        return true;
+    }
+
+    // 创建线程对象和它的计数槽
+    std::unique_ptr<Thread> makeThread()
+    {
+        auto slot = std::make_unique<WorkerSlot>();
+        WorkerSlot *ps = slot.get();
+        auto ptr = std::make_unique<Thread>([this, ps](int threadId)
+                                            { threadFunc(threadId, ps); });
+        slots_.emplace(ptr->getId(), std::move(slot));
+        return ptr;
+    }
+
+    // 创建并启动一个线程 调用方持有taskQueMtx_
+    void addThread()
+    {
+        auto ptr = makeThread();
+        int threadId = ptr->getId();
+        // unique_ptr不允许右值拷贝 move移动语义
+        threads_.emplace(threadId, std::move(ptr));
+        // 启动线程
+        threads_[threadId]->start();
+        // 修改线程个数变量
+        curThreadSize_++;
+    }
+
+    // 当前线程退出：从线程列表删除 调用方持有taskQueMtx_
+    void removeThread(int threadId)
+    {
+        threads_.erase(threadId);
+        slots_.erase(threadId);
+        curThreadSize_--;
+        std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
+        exitCond_.notify_all();
+    }
+
+    // 工作线程的计数槽 独占一条缓存行，只有所属线程写，读的时候再汇总
+    struct alignas(CACHE_LINE_SIZE) WorkerSlot
+    {
+        std::atomic_bool busy{false}; // 正在执行任务
+    };
+
+    // 空闲线程数量 由各线程计数槽汇总 调用方持有taskQueMtx_
+    int idleThreadSize() const
+    {
+        int busy = 0;
+        for (auto &it : slots_)
+        {
+            if (it.second->busy.load(std::memory_order_relaxed))
+                busy++;
+        }
+        return curThreadSize_ - busy;
+    }
+
     // 定义线程函数
-    void threadFunc(int threadId)
+    void threadFunc(int threadId, WorkerSlot *slot)
     {
         auto lastTime = std::chrono::high_resolution_clock().now();
+        // 只有cached模式扩容时读busy标记，fixed模式不写 模式启动后不会再变
+        const bool trackBusy = poolMode_ == PoolMode::MODE_CACHED;
         for (;;)
         {
             Task task;
@@ -200,15 +438,20 @@ private:
 
                 std::cout << std::this_thread::get_id() << "尝试获取任务" << std::endl;
                 // 双重判断，对应pool先拿到锁，形成死锁
-                while (taskQue_.size() == 0)
+                while (taskQue_.size() == 0 || retireThreadSize_ > 0)
                 {
+                    // resize/setMaxThreads要求减少线程，取任务前退出
+                    if (retireThreadSize_ > 0)
+                    {
+                        retireThreadSize_--;
+                        removeThread(threadId);
+                        return;
+                    }
                     // 没有任务且已经析构，销毁线程池对象
                     if (!isPoolRunning_)
                     {
                         // 把线程对象从线程容器里删除
-                        threads_.erase(threadId);
-                        std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
-                        exitCond_.notify_all();
+                        removeThread(threadId);
                         return;
                     }
                     if (poolMode_ == PoolMode::MODE_CACHED)
@@ -223,11 +466,7 @@ private:
                             {
                                 /*闲置了60s，回收当前线程*/
                                 // 把线程对象从线程容器里删除
-                                threads_.erase(threadId);
-                                // 记录线程数量的相关变量值修改
-                                curThreadSize_--;
-                                idleThreadSize_--;
-                                std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
+                                removeThread(threadId);
                                 return;
                             }
                         }
@@ -238,8 +477,9 @@ private:
                         notEmpty_.wait(lock);
                     }
                 }
-                // 消费了，空闲线程--
-                idleThreadSize_--;
+                // 消费了，标记为忙碌
+                if (trackBusy)
+                    slot->busy.store(true, std::memory_order_relaxed);
                 // 从任务队列取一个任务
                 task = taskQue_.front();
                 taskQue_.pop();
@@ -258,14 +498,38 @@ private:
             {
                 // task->run();
                 // 执行任务，完后将返回值setVal到Result
-                task();
+                // 任务的异常已经交给future，这里兜底，保证工作线程不会因为任务异常退出
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    onTaskError(std::current_exception());
+                }
             }
-            // 处理完了，空闲线程++
-            idleThreadSize_++;
+            // 处理完了，标记为空闲
+            if (trackBusy)
+                slot->busy.store(false, std::memory_order_relaxed);
             lastTime = std::chrono::high_resolution_clock().now();
         }
     }
 
+    // 任务抛出异常：计数并调用异常回调，回调自己抛出的异常直接忽略
+    void onTaskError(std::exception_ptr ex)
+    {
+        failedTaskSize_++;
+        if (!errorHandler_)
+            return;
+        try
+        {
+            errorHandler_(ex);
+        }
+        catch (...)
+        {
+        }
+    }
+
     // 检查pool运行状态
     bool checkRunningState() const
     {
@@ -273,24 +537,38 @@ private:
     }
 
 private:
+    /**
+     * 成员按读写频率分组：冷的配置、线程列表放在前面；
+     * 每个任务都会碰的队列锁、队列、条件变量各自从新的缓存行开始，互不干扰
+     */
+
+    // 配置 启动后只在运行期调整时修改，受taskQueMtx_保护
+    int initThreadSize_;             // 初始线程数量
+    int threadMaxSizeThreshold_;     // 线程数量上限
+    int taskQueThreshold_;           // 任务队列上限阈值
+    PoolMode poolMode_;              // 线程池模式
+    std::atomic_bool isPoolRunning_; // 线程池启动状态
+    ErrorHandler errorHandler_;      // 任务异常回调
+
+    // 线程列表 受taskQueMtx_保护，只在线程创建、退出时修改
     // std::vector<std::unique_ptr<Thread>> threads_; // 线程列表
-    std::unordered_map<int, std::unique_ptr<Thread>> threads_; // 线程列表
-    int initThreadSize_;                                       // 初始线程数量
-    int threadMaxSizeThreshold_;                               // 线程数量上限
-    std::atomic_int curThreadSize_;                            // 当前线程总数量
+    std::unordered_map<int, std::unique_ptr<Thread>> threads_;   // 线程列表
+    std::unordered_map<int, std::unique_ptr<WorkerSlot>> slots_; // 线程计数槽
+    std::atomic_int curThreadSize_;                              // 当前线程总数量
+    int retireThreadSize_;                                       // 等待退出的线程数量
+    std::condition_variable exitCond_;                           // 等待线程资源回收
 
+    // 任务队列 受taskQueMtx_保护
+    alignas(CACHE_LINE_SIZE) std::mutex taskQueMtx_; // 保证任务队列线程安全
     // std::queue<std::shared_ptr<Task>> taskQue_; // 任务队列，用智能指针保证用户任务的管理
-    using Task = std::function<void()>;
     std::queue<Task> taskQue_;
-    std::atomic_int taskSize_; // 任务数量
-    int taskQueThreshold_;     // 任务队列上限阈值
+    int taskSize_; // 任务数量
 
-    std::mutex taskQueMtx_;            // 保证任务队列线程安全
-    std::condition_variable notFull_;  // 任务队列不满
-    std::condition_variable notEmpty_; // 任务队列不空
-    std::condition_variable exitCond_; // 等待线程资源回收
+    alignas(CACHE_LINE_SIZE) std::condition_variable notEmpty_; // 任务队列不空 工作线程等待
+    alignas(CACHE_LINE_SIZE) std::condition_variable notFull_;  // 任务队列不满 提交者等待
 
-    PoolMode poolMode_;              // 线程池模式
-    std::atomic_bool isPoolRunning_; // 线程池启动状态
-    std::atomic_int idleThreadSize_; // 空闲线程数量
+    alignas(CACHE_LINE_SIZE) ShardedMap<std::string, std::any> inflight_; // 合并提交：在途任务的shared_future
+    std::unique_ptr<LruCache<std::string, std::any>> resultCache_;          // 合并提交：结果缓存，未开启为空
+
+    alignas(CACHE_LINE_SIZE) std::atomic_long failedTaskSize_; // 抛出异常的任务数量 只在任务失败时写
 };
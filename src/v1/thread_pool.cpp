@@ -18,7 +18,16 @@ void Task::exec()
 {
     if (result_ != nullptr)
     {
-        result_->setVal(run());
+        // 异常交给Result，再抛给线程池计数，避免用户在get上永远阻塞
+        try
+        {
+            result_->setVal(run());
+        }
+        catch (...)
+        {
+            result_->setException(std::current_exception());
+            throw;
+        }
     }
 }
 
@@ -36,7 +45,9 @@ Any Result::get()
 {
     if (!isValid_)
         return "";
-    sem_.wait();            // 若task没有执行完，会阻塞用户进程
+    sem_.wait(); // 若task没有执行完，会阻塞用户进程
+    if (ex_)
+        std::rethrow_exception(ex_);
     return std::move(any_); // 禁止左值赋值
 }
 
@@ -46,6 +57,12 @@ void Result::setVal(Any any)
     sem_.post(); // 已经获取任务返回值，sem+1
 }
 
+void Result::setException(std::exception_ptr ex)
+{
+    ex_ = ex;
+    sem_.post();
+}
+
 /**
  * 线程池对象
  */
@@ -57,7 +74,8 @@ ThreadPool::ThreadPool() : initThreadSize_(0),
                            isPoolRunning_(false),
                            idleThreadSize_(0),
                            threadMaxSizeThreshold_(THREAD_MAX_THRESHOLD),
-                           curThreadSize_(0)
+                           curThreadSize_(0),
+                           failedTaskSize_(0)
 {
 }
 
@@ -100,6 +118,36 @@ void ThreadPool::setThreadSizeThreshold(int threshold)
         threadMaxSizeThreshold_ = threshold;
 }
 
+// 设置任务异常回调
+void ThreadPool::setErrorHandler(ErrorHandler handler)
+{
+    // 不允许启动之后设置
+    if (checkRunningState())
+        return;
+    errorHandler_ = handler;
+}
+
+// 抛出异常的任务数量
+long ThreadPool::failedTaskCount() const
+{
+    return failedTaskSize_;
+}
+
+// 任务抛出异常：计数并调用异常回调，回调自己抛出的异常直接忽略
+void ThreadPool::onTaskError(std::exception_ptr ex)
+{
+    failedTaskSize_++;
+    if (!errorHandler_)
+        return;
+    try
+    {
+        errorHandler_(ex);
+    }
+    catch (...)
+    {
+    }
+}
+
 // 提交任务
 Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
 {
@@ -150,20 +198,22 @@ void ThreadPool::start(int initThreadSize)
     initThreadSize_ = initThreadSize;
     curThreadSize_ = initThreadSize;
     // 创建线程对象
+    std::vector<int> created;
     for (int i = 0; i < initThreadSize_; i++)
     {
         // 创建线程对象，把线程函数给到thread对象
         // move移动
         auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
         int threadId = ptr->getId();
+        created.push_back(threadId);
         // unique_ptr不允许右值拷贝 move移动语义
         threads_.emplace(threadId, std::move(ptr));
     }
 
-    // 启动所有线程
-    for (int i = 0; i < initThreadSize_; i++)
+    // 启动所有线程 线程id在多个线程池间全局递增，不能按下标取
+    for (int threadId : created)
     {
-        threads_[i]->start();
+        threads_[threadId]->start();
         idleThreadSize_++; // 记录初始空闲线程数量
     }
 }
@@ -253,7 +303,15 @@ void ThreadPool::threadFunc(int threadId)
         {
             // task->run();
             // 执行任务，完后将返回值setVal到Result
-            task->exec();
+            // 任务抛出异常不能带走工作线程
+            try
+            {
+                task->exec();
+            }
+            catch (...)
+            {
+                onTaskError(std::current_exception());
+            }
         }
         // 处理完了，空闲线程++
         idleThreadSize_++;
@@ -272,7 +330,7 @@ Thread::Thread(ThreadFunc func)
 
 Thread::~Thread() {}
 
-int Thread::genId_ = 0;
+std::atomic_int Thread::genId_{0};
 
 // 获取id
 int Thread::getId() const
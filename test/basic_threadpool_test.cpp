@@ -0,0 +1,242 @@
+#include "basic_threadpool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * BasicThreadPool测试
+ * 覆盖两个预设和全部16种策略组合，另外单独测LockFreeQueue和InlineFunction
+ */
+
+// 多个提交者并发提交，结果一个不少 容量很小时提交者要反复等待notFull_
+template <typename Pool>
+void testSubmit(int capacity)
+{
+    Pool pool;
+    pool.setTaskQueThreshold(capacity);
+    pool.start(2);
+
+    const int producerSize = 4;
+    const int taskSize = 500;
+    std::vector<std::thread> producers;
+    std::vector<long> sums(producerSize, 0);
+    for (int p = 0; p < producerSize; p++)
+    {
+        producers.emplace_back([&, p]()
+                               {
+                                   std::vector<std::future<int>> res;
+                                   for (int i = 0; i < taskSize; i++)
+                                       res.push_back(pool.submitTask([](int a, int b)
+                                                                     { return a + b; },
+                                                                     i, 1));
+                                   for (auto &r : res)
+                                       sums[p] += r.get(); });
+    }
+    for (std::thread &t : producers)
+        t.join();
+    for (long sum : sums)
+        CHECK(sum == static_cast<long>(taskSize) * (taskSize + 1) / 2);
+}
+
+// 任务异常进future，计数和回调都要对上，回调自己抛异常也不影响
+template <typename Pool>
+void testException()
+{
+    Pool pool;
+    std::atomic_int handled{0};
+    pool.setErrorHandler([&](std::exception_ptr)
+                         {
+                             handled++;
+                             throw std::runtime_error("handler"); });
+    pool.start(2);
+
+    std::future<int> bad = pool.submitTask([]() -> int
+                                           { throw std::runtime_error("task"); });
+    bool caught = false;
+    try
+    {
+        bad.get();
+    }
+    catch (const std::runtime_error &)
+    {
+        caught = true;
+    }
+    CHECK(caught);
+    CHECK(pool.trySubmitTask([]()
+                             { throw 1; }));
+    for (int i = 0; i < 500 && pool.failedTaskCount() < 2; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(pool.failedTaskCount() == 2);
+    CHECK(handled == 2);
+    // 工作线程没有因为异常退出
+    CHECK(pool.submitTask([]()
+                          { return 7; })
+              .get() == 7);
+}
+
+// 析构时队列里还有任务：已启动的线程池先执行完再退出
+template <typename Pool>
+void testDestroyWithQueuedTasks()
+{
+    std::atomic_int done{0};
+    {
+        Pool pool;
+        pool.setTaskQueThreshold(64);
+        pool.start(1);
+        pool.submitTask([]()
+                        { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+        for (int i = 0; i < 32; i++)
+            pool.submitTask([&]()
+                            { done++; });
+    }
+    CHECK(done == 32);
+
+    // 没有启动的线程池析构时丢弃任务，future报broken_promise
+    std::future<int> res;
+    {
+        Pool pool;
+        res = pool.submitTask([]()
+                              { return 1; });
+    }
+    bool broken = false;
+    try
+    {
+        res.get();
+    }
+    catch (const std::future_error &e)
+    {
+        broken = e.code() == std::future_errc::broken_promise;
+    }
+    CHECK(broken);
+}
+
+template <typename Pool>
+void testPool()
+{
+    testSubmit<Pool>(TASK_MAX_THRESHOLD);
+    testSubmit<Pool>(1);
+    testSubmit<Pool>(2);
+    testException<Pool>();
+    testDestroyWithQueuedTasks<Pool>();
+}
+
+template <template <typename, typename> class Q, typename W, typename S>
+void testSizes()
+{
+    testPool<BasicThreadPool<Q, W, S, FixedSize>>();
+    testPool<BasicThreadPool<Q, W, S, ElasticSize>>();
+}
+
+template <template <typename, typename> class Q, typename W>
+void testStorages()
+{
+    testSizes<Q, W, std::function<void()>>();
+    testSizes<Q, W, InlineFunction<64>>();
+}
+
+template <template <typename, typename> class Q>
+void testWaits()
+{
+    testStorages<Q, ParkWait>();
+    testStorages<Q, SpinWait>();
+}
+
+// 多生产者多消费者：每个元素恰好出队一次
+void testLockFreeQueue()
+{
+    LockFreeQueue<long, std::allocator<long>> que(2);
+    CHECK(que.capacity() == 2);
+
+    const int producerSize = 4;
+    const long itemSize = 20000;
+    std::atomic_long popped{0};
+    std::vector<std::vector<long>> got(producerSize);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producerSize; p++)
+    {
+        threads.emplace_back([&, p]()
+                             {
+                                 for (long i = 0; i < itemSize; i++)
+                                 {
+                                     long item = p * itemSize + i;
+                                     while (!que.try_push(std::move(item)))
+                                         std::this_thread::yield();
+                                 } });
+        threads.emplace_back([&, p]()
+                             {
+                                 long item;
+                                 while (popped < producerSize * itemSize)
+                                 {
+                                     if (que.try_pop(item))
+                                     {
+                                         got[p].push_back(item);
+                                         popped++;
+                                     }
+                                     else
+                                     {
+                                         std::this_thread::yield();
+                                     }
+                                 } });
+    }
+    for (std::thread &t : threads)
+        t.join();
+    std::set<long> all;
+    for (auto &v : got)
+        all.insert(v.begin(), v.end());
+    CHECK(popped == producerSize * itemSize);
+    CHECK(static_cast<long>(all.size()) == producerSize * itemSize);
+    long item;
+    CHECK(!que.try_pop(item));
+}
+
+// 记录存活对象数量，检查InlineFunction移动、析构不多不少
+struct Tracked
+{
+    static inline int alive = 0;
+    int *calls;
+    explicit Tracked(int *c) : calls(c) { alive++; }
+    Tracked(const Tracked &other) : calls(other.calls) { alive++; }
+    Tracked(Tracked &&other) noexcept : calls(other.calls) { alive++; }
+    ~Tracked() { alive--; }
+    void operator()() { (*calls)++; }
+};
+
+void testInlineFunction()
+{
+    int calls = 0;
+    {
+        InlineFunction<64> a(Tracked{&calls});
+        CHECK(Tracked::alive == 1);
+        a();
+        InlineFunction<64> b(std::move(a));
+        CHECK(!a);
+        CHECK(Tracked::alive == 1);
+        b();
+        InlineFunction<64> c;
+        CHECK(!c);
+        c = std::move(b);
+        CHECK(Tracked::alive == 1);
+        c();
+        // 覆盖已有的callable时旧的要析构
+        c = InlineFunction<64>(Tracked{&calls});
+        CHECK(Tracked::alive == 1);
+    }
+    CHECK(Tracked::alive == 0);
+    CHECK(calls == 3);
+}
+
+int main()
+{
+    testLockFreeQueue();
+    testInlineFunction();
+    testPool<FixedThreadPool>();
+    testPool<CachedThreadPool>();
+    testWaits<MutexQueue>();
+    testWaits<LockFreeQueue>();
+    std::cout << "basic_threadpool_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include "threadpool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * 合并提交和结果缓存测试
+ * 同key并发提交只执行一次；TTL过期后重新执行；异常共享但不缓存；LruCache总容量不超过capacity
+ */
+
+// 各种容量下缓存住的项数不超过容量，容量够用时全部留下
+void testLruCapacity()
+{
+    for (size_t capacity : {0, 1, 5, 16, 17, 100})
+    {
+        LruCache<std::string, int> cache(capacity);
+        const int itemSize = 1000;
+        for (int i = 0; i < itemSize; i++)
+            cache.put(std::to_string(i), i);
+        size_t hit = 0;
+        int value = 0;
+        for (int i = 0; i < itemSize; i++)
+        {
+            if (cache.get(std::to_string(i), value))
+            {
+                CHECK(value == i);
+                hit++;
+            }
+        }
+        CHECK(hit <= capacity);
+    }
+
+    // 容量为1：新key淘汰旧key
+    LruCache<std::string, int> one(1);
+    int value = 0;
+    one.put("a", 1);
+    CHECK(one.get("a", value) && value == 1);
+    one.put("b", 2);
+    CHECK(!one.get("a", value));
+    CHECK(one.get("b", value) && value == 2);
+
+    // 容量为0：什么都不缓存
+    LruCache<std::string, int> zero(0);
+    zero.put("a", 1);
+    CHECK(!zero.get("a", value));
+    zero.erase("a");
+}
+
+// 过期后get不到；同key重新put刷新过期时间
+void testLruTtl()
+{
+    LruCache<std::string, int> cache(8, std::chrono::milliseconds(100));
+    int value = 0;
+    cache.put("a", 1);
+    cache.put("b", 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    cache.put("b", 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(!cache.get("a", value));
+    CHECK(cache.get("b", value) && value == 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    CHECK(!cache.get("b", value));
+}
+
+// 多个提交者同时提交同一个key，函数只执行一次，所有人拿到同一个结果
+void testSingleFlight()
+{
+    ThreadPool pool;
+    pool.start(4);
+
+    std::atomic_int calls{0};
+    std::atomic_bool released{false};
+    auto slow = [&]()
+    {
+        calls++;
+        while (!released)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 42;
+    };
+
+    const int producerSize = 4;
+    const int submitSize = 25;
+    std::vector<std::shared_future<int>> res(producerSize * submitSize);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerSize; p++)
+    {
+        producers.emplace_back([&, p]()
+                               {
+                                   for (int i = 0; i < submitSize; i++)
+                                       res[p * submitSize + i] = pool.submitCoalesced("key", slow); });
+    }
+    for (std::thread &t : producers)
+        t.join();
+    released = true;
+    for (auto &r : res)
+        CHECK(r.get() == 42);
+    CHECK(calls == 1);
+
+    // 没开缓存，完成后再提交会重新执行
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 2);
+}
+
+// 缓存命中不执行，过期后重新执行并刷新缓存
+void testCacheTtl()
+{
+    ThreadPool pool;
+    pool.setResultCache(64, std::chrono::milliseconds(200));
+    pool.start(2);
+
+    std::atomic_int calls{0};
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 1);
+    // 缓存有效期内直接返回旧结果
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 1);
+    CHECK(calls == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 2);
+    // 新结果重新进缓存
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 2);
+    CHECK(calls == 2);
+}
+
+// 容量为0关闭缓存，每次都重新执行
+void testCacheDisabled()
+{
+    ThreadPool pool;
+    pool.setResultCache(0);
+    pool.start(2);
+
+    std::atomic_int calls{0};
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 1);
+    CHECK(pool.submitCoalesced("key", [&]()
+                               { return ++calls; })
+              .get() == 2);
+}
+
+// 容量为1：两个key交替提交互相淘汰
+void testCacheCapacityOne()
+{
+    ThreadPool pool;
+    pool.setResultCache(1);
+    pool.start(2);
+
+    std::atomic_int calls{0};
+    auto run = [&](const std::string &key)
+    {
+        return pool.submitCoalesced(key, [&]()
+                                    { return ++calls; })
+            .get();
+    };
+    CHECK(run("a") == 1);
+    CHECK(run("a") == 1);
+    CHECK(run("b") == 2);
+    CHECK(run("a") == 3);
+}
+
+// 异常由同一批等待者共享，但不进缓存，下次提交重新执行
+void testExceptionNotCached()
+{
+    ThreadPool pool;
+    pool.setResultCache(64);
+    std::atomic_int handled{0};
+    pool.setErrorHandler([&](std::exception_ptr)
+                         { handled++; });
+    pool.start(2);
+
+    std::atomic_int calls{0};
+    std::atomic_bool released{false};
+    auto bad = [&]() -> int
+    {
+        calls++;
+        while (!released)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        throw std::runtime_error("coalesced");
+    };
+    std::vector<std::shared_future<int>> res;
+    for (int i = 0; i < 50; i++)
+        res.push_back(pool.submitCoalesced("key", bad));
+    released = true;
+    for (auto &r : res)
+    {
+        bool caught = false;
+        try
+        {
+            r.get();
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        CHECK(caught);
+    }
+    CHECK(calls == 1);
+    CHECK(handled == 1);
+    CHECK(pool.failedTaskCount() == 1);
+
+    CHECK(pool.submitCoalesced("key", []()
+                               { return 3; })
+              .get() == 3);
+    // 成功的结果才缓存
+    CHECK(pool.submitCoalesced("key", []()
+                               { return 4; })
+              .get() == 3);
+}
+
+int main()
+{
+    testLruCapacity();
+    testLruTtl();
+    testSingleFlight();
+    testCacheTtl();
+    testCacheDisabled();
+    testCacheCapacityOne();
+    testExceptionNotCached();
+    std::cout << "coalesce_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "io_reactor.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+/**
+ * IoReactor测试
+ * 在途请求未完成时析构不能卡住，线程池队列满时回调不能丢
+ */
+
+// 管道读端没有数据，读请求一直在途，析构要取消它并返回
+void testDestroyWithPendingRead()
+{
+    ThreadPool pool;
+    pool.start(2);
+    int fds[2];
+    CHECK(::pipe(fds) == 0);
+
+    char buf[16];
+    char cbBuf[16];
+    std::atomic_int cbResult{1};
+    std::future<ssize_t> res;
+    auto begin = std::chrono::steady_clock::now();
+    {
+        IoReactor<> io(pool);
+        res = io.async_read(fds[0], buf, sizeof(buf), 0);
+        io.async_read(fds[0], cbBuf, sizeof(cbBuf), 0, [&](ssize_t n)
+                      { cbResult = static_cast<int>(n); });
+    }
+    CHECK(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+    CHECK(res.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    CHECK(res.get() < 0);
+    // 回调在线程池上执行，等它跑完
+    for (int i = 0; i < 500 && cbResult == 1; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(cbResult < 0);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// 一个请求完成时另一个仍在途，之后析构也要返回
+void testDestroyAfterPartialCompletion()
+{
+    ThreadPool pool;
+    pool.start(2);
+    int a[2], b[2];
+    CHECK(::pipe(a) == 0);
+    CHECK(::pipe(b) == 0);
+
+    char bufA[16], bufB[16];
+    {
+        IoReactor<> io(pool);
+        std::future<ssize_t> ra = io.async_read(a[0], bufA, sizeof(bufA), 0);
+        std::future<ssize_t> rb = io.async_read(b[0], bufB, sizeof(bufB), 0);
+        CHECK(::write(a[1], "hello", 5) == 5);
+        // 退化模式用pread，管道直接返回-ESPIPE
+        if (io.usingUring())
+        {
+            CHECK(ra.get() == 5);
+            CHECK(rb.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+        }
+    }
+    ::close(a[0]);
+    ::close(a[1]);
+    ::close(b[0]);
+    ::close(b[1]);
+}
+
+// 线程池队列容量为1且工作线程被占住，所有回调仍然都要执行
+void testCallbacksSurviveFullQueue()
+{
+    ThreadPool pool;
+    pool.setTaskQueThreshold(1);
+    pool.start(1);
+
+    char path[] = "/tmp/io_reactor_testXXXXXX";
+    int fd = ::mkstemp(path);
+    CHECK(fd >= 0);
+    ::unlink(path);
+
+    const int total = 200;
+    std::atomic_int called{0};
+    char buf[8] = "reactor";
+    {
+        IoReactor<> io(pool);
+        for (int i = 0; i < total; i++)
+        {
+            io.async_write(fd, buf, sizeof(buf), i * sizeof(buf), [&](ssize_t n)
+                           {
+                               CHECK(n == sizeof(buf) || n == -ECANCELED);
+                               // 第一个回调占住唯一的工作线程，让后面的回调进不了队列
+                               if (called++ == 0)
+                                   std::this_thread::sleep_for(std::chrono::milliseconds(200)); });
+        }
+    }
+    for (int i = 0; i < 500 && called < total; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(called == total);
+    ::close(fd);
+}
+
+int main()
+{
+    testDestroyWithPendingRead();
+    testDestroyAfterPartialCompletion();
+    testCallbacksSurviveFullQueue();
+    std::cout << "io_reactor_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * 测试公用的断言 失败时输出位置并以非0退出，ctest据此判定失败
+ */
+
+#define CHECK(cond)                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (!(cond))                                                             \
+        {                                                                        \
+            std::cerr << __FILE__ << ":" << __LINE__ << " CHECK failed: " #cond \
+                      << std::endl;                                              \
+            std::exit(1);                                                        \
+        }                                                                        \
+    } while (0)
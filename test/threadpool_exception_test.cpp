@@ -0,0 +1,132 @@
+#include "threadpool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * ThreadPool任务异常测试
+ * 异常进future，工作线程不退出，failedTaskCount和回调次数对得上，回调自己抛异常也不影响
+ */
+
+// 计数是在工作线程上更新的，等一会儿再比较
+void waitFailed(ThreadPool &pool, long expect)
+{
+    for (int i = 0; i < 500 && pool.failedTaskCount() < expect; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(pool.failedTaskCount() == expect);
+}
+
+// 好坏任务交替提交，坏任务的future重新抛出，好任务结果全对
+void testMixed(PoolMode mode, bool handlerThrows)
+{
+    ThreadPool pool;
+    pool.setMode(mode);
+    std::atomic_int handled{0};
+    pool.setErrorHandler([&](std::exception_ptr ex)
+                         {
+                             handled++;
+                             // 回调拿到的就是任务抛出的异常
+                             try
+                             {
+                                 std::rethrow_exception(ex);
+                             }
+                             catch (const std::runtime_error &)
+                             {
+                             }
+                             if (handlerThrows)
+                                 throw std::logic_error("handler"); });
+    pool.start(2);
+
+    const int taskSize = 200;
+    std::vector<std::future<int>> res;
+    for (int i = 0; i < taskSize; i++)
+    {
+        res.push_back(pool.submitTask([](int n) -> int
+                                      {
+                                          if (n % 2)
+                                              throw std::runtime_error("odd");
+                                          return n; },
+                                      i));
+    }
+    for (int i = 0; i < taskSize; i++)
+    {
+        if (i % 2 == 0)
+        {
+            CHECK(res[i].get() == i);
+            continue;
+        }
+        bool caught = false;
+        try
+        {
+            res[i].get();
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        CHECK(caught);
+    }
+    waitFailed(pool, taskSize / 2);
+    CHECK(handled == taskSize / 2);
+
+    // 不关心返回值的任务抛异常，只计数和回调
+    CHECK(pool.trySubmitTask([]()
+                             { throw std::runtime_error("fire and forget"); }));
+    waitFailed(pool, taskSize / 2 + 1);
+    CHECK(handled == taskSize / 2 + 1);
+
+    // 两个工作线程都还活着
+    std::atomic_int running{0};
+    std::atomic_bool both{false};
+    std::vector<std::future<void>> probes;
+    for (int i = 0; i < 2; i++)
+    {
+        probes.push_back(pool.submitTask([&]()
+                                         {
+                                             running++;
+                                             for (int j = 0; j < 2000 && running < 2; j++)
+                                                 std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                             if (running == 2)
+                                                 both = true; }));
+    }
+    for (auto &p : probes)
+        p.get();
+    CHECK(both);
+}
+
+// 没有回调时照样计数
+void testNoHandler()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::future<void> res = pool.submitTask([]()
+                                            { throw 1; });
+    bool caught = false;
+    try
+    {
+        res.get();
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    CHECK(caught);
+    waitFailed(pool, 1);
+    CHECK(pool.submitTask([]()
+                          { return 7; })
+              .get() == 7);
+}
+
+int main()
+{
+    testMixed(PoolMode::MODE_FIXED, false);
+    testMixed(PoolMode::MODE_FIXED, true);
+    testMixed(PoolMode::MODE_CACHED, false);
+    testMixed(PoolMode::MODE_CACHED, true);
+    testNoHandler();
+    std::cout << "threadpool_exception_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "threadpool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+/**
+ * ThreadPool运行期调整测试
+ * 减少线程时排队的任务不丢失、不乱序；撤销还没执行的回收；上限低于当前线程数时多出的线程退出
+ */
+
+// 占住工作线程的任务，release之前一直不返回
+class Gate
+{
+public:
+    void submitTo(ThreadPool &pool, int taskSize)
+    {
+        for (int i = 0; i < taskSize; i++)
+            res_.push_back(pool.submitTask([this]()
+                                           {
+                                               entered_++;
+                                               while (!released_)
+                                                   std::this_thread::sleep_for(std::chrono::milliseconds(1)); }));
+    }
+    // 等到n个任务都开始执行
+    void waitEntered(int n)
+    {
+        for (int i = 0; i < 2000 && entered_ < n; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CHECK(entered_ == n);
+    }
+    void release()
+    {
+        released_ = true;
+        for (auto &r : res_)
+            r.get();
+    }
+
+private:
+    std::atomic_int entered_{0};
+    std::atomic_bool released_{false};
+    std::vector<std::future<void>> res_;
+};
+
+// 提交足够多的阻塞任务，同时在执行的数量就是存活的线程数
+int liveThreads(ThreadPool &pool)
+{
+    std::atomic_int running{0};
+    std::atomic_int peak{0};
+    std::atomic_bool released{false};
+    std::vector<std::future<void>> res;
+    for (int i = 0; i < 16; i++)
+    {
+        res.push_back(pool.submitTask([&]()
+                                      {
+                                          int now = ++running;
+                                          int old = peak;
+                                          while (now > old && !peak.compare_exchange_weak(old, now))
+                                              ;
+                                          while (!released)
+                                              std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                          running--; }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    released = true;
+    for (auto &r : res)
+        r.get();
+    return peak;
+}
+
+// 4个线程都在忙时缩到1个，排队的任务由剩下的一个线程按提交顺序执行
+void testShrinkKeepsOrder()
+{
+    ThreadPool pool;
+    pool.start(4);
+    Gate gate;
+    gate.submitTo(pool, 4);
+    gate.waitEntered(4);
+
+    const int taskSize = 200;
+    std::mutex mtx;
+    std::vector<int> order;
+    std::vector<std::future<void>> res;
+    for (int i = 0; i < taskSize; i++)
+    {
+        res.push_back(pool.submitTask([&, i]()
+                                      {
+                                          std::lock_guard<std::mutex> lock(mtx);
+                                          order.push_back(i); }));
+    }
+    pool.resize(1);
+    gate.release();
+    for (auto &r : res)
+        r.get();
+
+    CHECK(static_cast<int>(order.size()) == taskSize);
+    for (int i = 0; i < taskSize; i++)
+        CHECK(order[i] == i);
+    CHECK(liveThreads(pool) == 1);
+}
+
+// 缩小后还没有线程退出时又扩大：先撤销回收，不够再建新线程
+void testGrowAfterShrink()
+{
+    ThreadPool pool;
+    pool.start(4);
+    Gate gate;
+    gate.submitTo(pool, 4);
+    gate.waitEntered(4);
+
+    pool.resize(1); // 3个线程等待回收，但都在忙
+    pool.resize(3); // 撤销其中2个，不新建线程
+    // 没有新线程，工作线程都被占着，新任务只能排队
+    std::atomic_bool ran{false};
+    std::future<void> probe = pool.submitTask([&]()
+                                              { ran = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(!ran);
+    gate.release();
+    probe.get();
+    CHECK(liveThreads(pool) == 3);
+
+    pool.resize(6);
+    CHECK(liveThreads(pool) == 6);
+}
+
+// 线程上限调到当前线程数以下，多出的线程退出；之后resize也不能超过上限
+void testMaxThreadsBelowLive()
+{
+    ThreadPool pool;
+    pool.start(4);
+    pool.setMaxThreads(2);
+    CHECK(liveThreads(pool) == 2);
+
+    pool.resize(8);
+    CHECK(liveThreads(pool) == 2);
+
+    pool.setMaxThreads(5);
+    pool.resize(5);
+    CHECK(liveThreads(pool) == 5);
+}
+
+int main()
+{
+    testShrinkKeepsOrder();
+    testGrowAfterShrink();
+    testMaxThreadsBelowLive();
+    std::cout << "threadpool_resize_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "thread_pool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * v1 ThreadPool任务异常测试
+ * Result::get重新抛出异常而不是一直阻塞，工作线程不退出，failedTaskCount和回调次数对得上
+ */
+
+// 奇数抛异常，偶数返回自身
+class ParityTask : public Task
+{
+public:
+    explicit ParityTask(int n) : n_(n) {}
+    Any run()
+    {
+        if (n_ % 2)
+            throw std::runtime_error("odd");
+        return n_;
+    }
+
+private:
+    int n_;
+};
+
+// 两个任务互相等待对方开始，都能结束说明两个工作线程都活着
+class RendezvousTask : public Task
+{
+public:
+    explicit RendezvousTask(std::atomic_int *running) : running_(running) {}
+    Any run()
+    {
+        (*running_)++;
+        for (int i = 0; i < 2000 && *running_ < 2; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return running_->load() >= 2;
+    }
+
+private:
+    std::atomic_int *running_;
+};
+
+// 计数在get返回之后才更新，等一会儿再比较
+void waitFailed(ThreadPool &pool, long expect)
+{
+    for (int i = 0; i < 500 && pool.failedTaskCount() < expect; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(pool.failedTaskCount() == expect);
+}
+
+void testMixed(PoolMode mode, bool handlerThrows)
+{
+    ThreadPool pool;
+    pool.setMode(mode);
+    std::atomic_int handled{0};
+    pool.setErrorHandler([&](std::exception_ptr)
+                         {
+                             handled++;
+                             if (handlerThrows)
+                                 throw std::logic_error("handler"); });
+    pool.start(2);
+
+    // Result不能拷贝也不能移动，只能原地构造
+    const int taskSize = 200;
+    std::vector<std::unique_ptr<Result>> res;
+    for (int i = 0; i < taskSize; i++)
+        res.emplace_back(new Result(pool.submitTask(std::make_shared<ParityTask>(i))));
+    for (int i = 0; i < taskSize; i++)
+    {
+        if (i % 2 == 0)
+        {
+            CHECK(res[i]->get().cast_<int>() == i);
+            continue;
+        }
+        bool caught = false;
+        try
+        {
+            res[i]->get();
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        CHECK(caught);
+    }
+    waitFailed(pool, taskSize / 2);
+    CHECK(handled == taskSize / 2);
+
+    std::atomic_int running{0};
+    Result a = pool.submitTask(std::make_shared<RendezvousTask>(&running));
+    Result b = pool.submitTask(std::make_shared<RendezvousTask>(&running));
+    CHECK(a.get().cast_<bool>());
+    CHECK(b.get().cast_<bool>());
+}
+
+int main()
+{
+    testMixed(PoolMode::MODE_FIXED, false);
+    testMixed(PoolMode::MODE_FIXED, true);
+    testMixed(PoolMode::MODE_CACHED, false);
+    testMixed(PoolMode::MODE_CACHED, true);
+    std::cout << "threadpool_v1_exception_test passed" << std::endl;
+    return 0;
+}